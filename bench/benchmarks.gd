@@ -0,0 +1,320 @@
+extends SceneTree
+## Micro benchmarks for the inventory system hot paths.
+##
+## Run headless from a project that has the extension installed:
+##   godot --headless -s res://bench/benchmarks.gd
+##   godot --headless -s res://bench/benchmarks.gd -- item_lookup
+## Every benchmark builds its own database and nodes, and prints one line per case
+## with the mean time of an operation in microseconds.
+
+const ITERATIONS := 10000
+
+var _benchmarks := {
+	"item_lookup": _bench_item_lookup,
+	"stack_scan": _bench_stack_scan,
+	"grid_sort": _bench_grid_sort,
+	"grid_batch": _bench_grid_batch,
+	"masked_placement": _bench_masked_placement,
+	"shaped_placement": _bench_shaped_placement,
+}
+
+
+func _initialize() -> void:
+	var selected := OS.get_cmdline_user_args()
+	seed(1)
+	for benchmark_name in _benchmarks:
+		if selected.is_empty() or selected.has(benchmark_name):
+			print("== ", benchmark_name)
+			_benchmarks[benchmark_name].call()
+	quit()
+
+
+func _report(case_name: String, start_usec: int, operations: int) -> void:
+	var elapsed := Time.get_ticks_usec() - start_usec
+	print("%-48s %10.3f us/op" % [case_name, float(elapsed) / maxi(operations, 1)])
+
+
+func _make_inventory(database: InventoryDatabase) -> Inventory:
+	var inventory := Inventory.new()
+	inventory.database = database
+	root.add_child(inventory)
+	return inventory
+
+
+func _make_grid(database: InventoryDatabase, size: Vector2i) -> GridInventory:
+	var grid := GridInventory.new()
+	grid.database = database
+	grid.size = size
+	return grid
+
+
+# One item per size of the mix, with ids "item_0", "item_1", ... in mix order.
+func _make_sized_database(sizes: Array) -> InventoryDatabase:
+	var database := InventoryDatabase.new()
+	for i in sizes.size():
+		var item := ItemDefinition.new()
+		item.id = "item_%d" % i
+		item.name = item.id
+		item.max_stack = 1
+		item.size = sizes[i]
+		database.add_new_item(item)
+	return database
+
+
+# Fills the grid with random items of the mix until about fill_ratio of the cells are taken.
+func _fill_grid(grid: GridInventory, sizes: Array, fill_ratio: float) -> int:
+	var target := int(grid.size.x * grid.size.y * fill_ratio)
+	var area := 0
+	var misses := 0
+	while area < target and misses < 64:
+		var item_index := randi() % sizes.size()
+		if grid.add("item_%d" % item_index, 1) == 0:
+			area += sizes[item_index].x * sizes[item_index].y
+		else:
+			misses += 1
+	return area
+
+
+func _make_database(item_count: int, size := Vector2i.ONE, max_stack := 64) -> InventoryDatabase:
+	var database := InventoryDatabase.new()
+	for i in item_count:
+		var item := ItemDefinition.new()
+		item.id = "item_%d" % i
+		item.name = item.id
+		item.max_stack = max_stack
+		item.size = size
+		database.add_new_item(item)
+	return database
+
+
+# InventoryDatabase.get_item against a scan of the items array, which is what the
+# database did before the id index.
+func _bench_item_lookup() -> void:
+	for item_count in [10, 100, 1000, 10000]:
+		var database := _make_database(item_count)
+		var ids := PackedStringArray()
+		for i in ITERATIONS:
+			ids.append("item_%d" % (randi() % item_count))
+
+		var start := Time.get_ticks_usec()
+		for id in ids:
+			database.get_item(id)
+		_report("get_item, %d items" % item_count, start, ids.size())
+
+		var items := database.get_items()
+		var scans := mini(ids.size(), 200000 / item_count)
+		start = Time.get_ticks_usec()
+		for i in scans:
+			for item in items:
+				if item.id == ids[i]:
+					break
+		_report("linear scan, %d items" % item_count, start, scans)
+
+
+# Inventory.add on a stack found after every other stack, and a category scan over
+# a category the database does not index, both walk the cached handles and amounts.
+func _bench_stack_scan() -> void:
+	for stack_count in [16, 128, 1024]:
+		var database := _make_database(stack_count, Vector2i.ONE, 1000000)
+		var inventory := _make_inventory(database)
+		for i in stack_count:
+			inventory.add("item_%d" % i, 1)
+		var last_id := "item_%d" % (stack_count - 1)
+
+		var start := Time.get_ticks_usec()
+		for i in ITERATIONS:
+			inventory.add(last_id, 1)
+		_report("add to last of %d stacks" % stack_count, start, ITERATIONS)
+
+		var category := ItemCategory.new()
+		category.id = "unindexed"
+		start = Time.get_ticks_usec()
+		for i in ITERATIONS:
+			inventory.get_amount_of_category(category)
+		_report("category scan, %d stacks" % stack_count, start, ITERATIONS)
+		inventory.free()
+
+
+const SIZE_MIXES := {
+	"small": [Vector2i(1, 1), Vector2i(1, 2), Vector2i(2, 1), Vector2i(2, 2)],
+	"mixed": [Vector2i(1, 1), Vector2i(1, 3), Vector2i(2, 2), Vector2i(2, 3), Vector2i(3, 1), Vector2i(4, 2)],
+	"large": [Vector2i(2, 2), Vector2i(2, 4), Vector2i(3, 3), Vector2i(4, 3), Vector2i(5, 2)],
+}
+
+
+# GridInventory.sort over random fills of each size mix at 70% of the cells, with
+# how many of the runs the packing succeeded. Every run fills a new grid.
+func _bench_grid_sort() -> void:
+	for grid_size in [Vector2i(10, 10), Vector2i(16, 16), Vector2i(32, 32)]:
+		for mix_name in SIZE_MIXES:
+			var sizes: Array = SIZE_MIXES[mix_name]
+			var database := _make_sized_database(sizes)
+			var runs := 20
+			var sorted := 0
+			var elapsed := 0
+			for run in runs:
+				var grid := _make_grid(database, grid_size)
+				_fill_grid(grid, sizes, 0.7)
+				var start := Time.get_ticks_usec()
+				if grid.sort():
+					sorted += 1
+				elapsed += Time.get_ticks_usec() - start
+				grid.free()
+			print("%-48s %10.3f us/op  %d/%d sorted" % ["sort %dx%d, %s" % [grid_size.x, grid_size.y, mix_name], float(elapsed) / runs, sorted, runs])
+
+
+# GridInventory.add_batch of a random set of items sized to fill about 70% of the
+# grid, against placing the same layout with one add_at_position per item, and
+# against adding the items one by one in arrival order.
+func _bench_grid_batch() -> void:
+	for grid_size in [Vector2i(10, 10), Vector2i(16, 16), Vector2i(32, 32)]:
+		for mix_name in SIZE_MIXES:
+			var sizes: Array = SIZE_MIXES[mix_name]
+			var database := _make_sized_database(sizes)
+			var target := int(grid_size.x * grid_size.y * 0.7)
+			var item_ids := PackedStringArray()
+			var amounts := PackedInt32Array()
+			var area := 0
+			while area < target:
+				var item_index := randi() % sizes.size()
+				item_ids.append("item_%d" % item_index)
+				amounts.append(1)
+				area += sizes[item_index].x * sizes[item_index].y
+			var case_name := "%dx%d, %s, %d items" % [grid_size.x, grid_size.y, mix_name, item_ids.size()]
+
+			var grid := _make_grid(database, grid_size)
+			var start := Time.get_ticks_usec()
+			var left := grid.add_batch(item_ids, amounts)
+			var elapsed := Time.get_ticks_usec() - start
+			var placed := 0
+			for amount in left:
+				if amount == 0:
+					placed += 1
+			print("%-48s %10.3f us/op  %d/%d placed" % ["add_batch " + case_name, float(elapsed), placed, item_ids.size()])
+
+			var layout := []
+			for stack in grid.stacks:
+				layout.append([stack.item_id, grid.get_stack_position(stack), grid.is_stack_rotated(stack)])
+			grid.free()
+			grid = _make_grid(database, grid_size)
+			start = Time.get_ticks_usec()
+			for entry in layout:
+				grid.add_at_position(entry[1], entry[0], 1, {}, entry[2])
+			elapsed = Time.get_ticks_usec() - start
+			print("%-48s %10.3f us/op  %d/%d placed" % ["add_at_position " + case_name, float(elapsed), grid.stacks.size(), item_ids.size()])
+			grid.free()
+
+			grid = _make_grid(database, grid_size)
+			placed = 0
+			start = Time.get_ticks_usec()
+			for item_id in item_ids:
+				if grid.add(item_id, 1) == 0:
+					placed += 1
+			elapsed = Time.get_ticks_usec() - start
+			print("%-48s %10.3f us/op  %d/%d placed" % ["add one by one " + case_name, float(elapsed), placed, item_ids.size()])
+			grid.free()
+
+
+# Allows the even rows and every third column. Declared position static it is read
+# once into the placement mask, otherwise it is asked for every candidate cell.
+class StripeConstraint extends GridInventoryConstraint:
+	var is_static := true
+
+	func _can_add_on_position(_inventory: Node, position: Vector2i, _item_id: String, _amount: int, _properties: Dictionary, _is_rotated: bool) -> bool:
+		return position.y % 2 == 0 or position.x % 3 == 0
+
+	func _is_position_static(_inventory: Node, _item_id: String) -> bool:
+		return is_static
+
+	func _get_allowed_positions(inventory: Node, _item_id: String, _is_rotated: bool) -> PackedInt64Array:
+		var grid_size: Vector2i = inventory.size
+		var rows := PackedInt64Array()
+		for y in grid_size.y:
+			var row := 0
+			for x in grid_size.x:
+				if y % 2 == 0 or x % 3 == 0:
+					row |= 1 << x
+			rows.append(row)
+		return rows
+
+
+# GridInventory.add and get_placement_map under a grid constraint, with it read
+# into the placement mask against asked per cell. Grids wider than 64 have no mask.
+func _bench_masked_placement() -> void:
+	var sizes := [Vector2i(2, 2)]
+	var database := _make_sized_database(sizes)
+	for grid_size in [Vector2i(16, 16), Vector2i(32, 32), Vector2i(64, 64)]:
+		for is_static in [true, false]:
+			var constraint := StripeConstraint.new()
+			constraint.is_static = is_static
+			var constraints: Array[GridInventoryConstraint] = [constraint]
+			var case_name := "%dx%d, %s" % [grid_size.x, grid_size.y, "mask" if is_static else "per cell"]
+
+			var grid := _make_grid(database, grid_size)
+			grid.grid_constraints = constraints
+			var maps := 100
+			var start := Time.get_ticks_usec()
+			for i in maps:
+				grid.get_placement_map("item_0")
+			_report("get_placement_map " + case_name, start, maps)
+
+			var added := 0
+			start = Time.get_ticks_usec()
+			while grid.add("item_0", 1) == 0:
+				added += 1
+			_report("add until full (%d) " % added + case_name, start, added + 1)
+			grid.free()
+
+
+# Item shapes as rows of cells, bit x of a row is cell x.
+const SHAPES := {
+	"L": [Vector2i(2, 3), [0b01, 0b01, 0b11]],
+	"ring": [Vector2i(4, 3), [0b1111, 0b1001, 0b1111]],
+}
+
+
+# GridInventory.get_placement_map and add of shaped items against rectangles of the
+# same size, in both rotations. add falls back to the rotated footprint once the
+# other one no longer fits, add_at_position is asked for every cell in one rotation.
+func _bench_shaped_placement() -> void:
+	var database := InventoryDatabase.new()
+	for shape_name in SHAPES:
+		for is_shaped in [true, false]:
+			var item := ItemDefinition.new()
+			item.id = shape_name if is_shaped else shape_name + "_rect"
+			item.name = item.id
+			item.max_stack = 1
+			item.size = SHAPES[shape_name][0]
+			if is_shaped:
+				item.shape = PackedInt64Array(SHAPES[shape_name][1])
+			database.add_new_item(item)
+	for grid_size in [Vector2i(16, 16), Vector2i(32, 32), Vector2i(64, 64)]:
+		for shape_name in SHAPES:
+			for item_id in [shape_name, shape_name + "_rect"]:
+				for is_rotated in [false, true]:
+					var case_name := "%dx%d, %s%s" % [grid_size.x, grid_size.y, item_id, ", rotated" if is_rotated else ""]
+					var grid := _make_grid(database, grid_size)
+					var maps := 100
+					var start := Time.get_ticks_usec()
+					for i in maps:
+						grid.get_placement_map(item_id, is_rotated)
+					_report("get_placement_map " + case_name, start, maps)
+
+					var added := 0
+					var tries := 0
+					start = Time.get_ticks_usec()
+					for y in grid_size.y:
+						for x in grid_size.x:
+							tries += 1
+							if grid.add_at_position(Vector2i(x, y), item_id, 1, {}, is_rotated) == 0:
+								added += 1
+					_report("add_at_position every cell (%d) " % added + case_name, start, tries)
+					grid.free()
+
+				var full_grid := _make_grid(database, grid_size)
+				var filled := 0
+				var fill_start := Time.get_ticks_usec()
+				while full_grid.add(item_id, 1) == 0:
+					filled += 1
+				_report("add until full (%d) %dx%d, %s" % [filled, grid_size.x, grid_size.y, item_id], fill_start, filled + 1)
+				full_grid.free()
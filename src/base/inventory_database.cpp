@@ -11,12 +11,37 @@
 
 void InventoryDatabase::_update_items_cache() {
 	items_cache.clear();
+	for (uint32_t handle = 0; handle < items_by_handle.size(); handle++) {
+		items_by_handle[handle] = Ref<ItemDefinition>();
+	}
 	for (size_t i = 0; i < items.size(); i++) {
 		Ref<ItemDefinition> item = items[i];
 		if (item != nullptr) {
 			items_cache[item->get_id()] = item;
+			_register_item_handle(item);
+			item->update_category_bits();
 		}
 	}
+	_rebuild_id_index<ItemDefinition>(items, items_index);
+}
+
+int InventoryDatabase::_register_item_handle(const Ref<ItemDefinition> &item) const {
+	StringName id = item->get_id();
+	int handle;
+	const int *existing = item_handles.getptr(id);
+	if (existing != nullptr) {
+		handle = *existing;
+	} else {
+		handle = item_handle_ids.size();
+		item_handles.insert(id, handle);
+		item_handle_ids.push_back(id);
+		items_by_handle.push_back(Ref<ItemDefinition>());
+	}
+	if (items_by_handle[handle].is_null()) {
+		items_by_handle[handle] = item;
+	}
+	item->set_handle(handle);
+	return handle;
 }
 
 void InventoryDatabase::_update_items_categories_cache() {
@@ -25,11 +50,77 @@ void InventoryDatabase::_update_items_categories_cache() {
 		Ref<ItemCategory> category = item_categories[i];
 		if (category == nullptr)
 			continue;
+		// Membership goes through the index, codes only fit the first 31 categories.
+		category->set_index(i);
+		int code = i < 31 ? 1 << i : 0;
 		if (!Engine::get_singleton()->is_editor_hint()) {
-			category->set_code(pow(2, i));
+			category->set_code(code);
+		}
+		if (code != 0)
+			categories_code_cache[code] = category;
+	}
+	_rebuild_id_index<ItemCategory>(item_categories, categories_index);
+	for (size_t i = 0; i < items.size(); i++) {
+		Ref<ItemDefinition> item = items[i];
+		if (item != nullptr)
+			item->update_category_bits();
+	}
+}
+
+void InventoryDatabase::_release_category_indices() {
+	// A category leaving the database must not match the bit of the one taking its index.
+	for (size_t i = 0; i < item_categories.size(); i++) {
+		Ref<ItemCategory> category = item_categories[i];
+		if (category != nullptr)
+			category->set_index(-1);
+	}
+}
+
+template <typename T>
+void InventoryDatabase::_rebuild_id_index(const Array &resources, IdIndex &index) const {
+	index.indexes.clear();
+	index.indexes.reserve(resources.size());
+	for (int64_t i = 0; i < resources.size(); i++) {
+		Ref<T> resource = resources[i];
+		if (resource.is_null())
+			continue;
+		StringName id = resource->get_id();
+		// Keep the first match, like the linear search this replaces.
+		if (!index.indexes.has(id))
+			index.indexes.insert(id, i);
+	}
+	index.indexed_size = resources.size();
+}
+
+template <typename T>
+Ref<T> InventoryDatabase::_find_by_id(const Array &resources, IdIndex &index, const String &id) const {
+	if (index.indexed_size != resources.size()) {
+		_rebuild_id_index<T>(resources, index);
+	}
+	const StringName key = id;
+	const int *found = index.indexes.getptr(key);
+	if (found != nullptr) {
+		Ref<T> resource = resources[*found];
+		if (resource.is_valid() && resource->get_id() == id)
+			return resource;
+		// The id was edited in place, refresh and try once more.
+		_rebuild_id_index<T>(resources, index);
+		found = index.indexes.getptr(key);
+		if (found != nullptr)
+			return resources[*found];
+		return nullptr;
+	}
+	if (Engine::get_singleton()->is_editor_hint()) {
+		// Editors rename resources directly, so a miss is not trusted there.
+		for (int64_t i = 0; i < resources.size(); i++) {
+			Ref<T> resource = resources[i];
+			if (resource.is_valid() && resource->get_id() == id) {
+				_rebuild_id_index<T>(resources, index);
+				return resource;
+			}
 		}
-		categories_code_cache[pow(2, i)] = category;
 	}
+	return nullptr;
 }
 
 void InventoryDatabase::_bind_methods() {
@@ -51,6 +142,9 @@ void InventoryDatabase::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("add_new_loot", "loot"), &InventoryDatabase::add_new_loot);
 	ClassDB::bind_method(D_METHOD("remove_loot", "loot"), &InventoryDatabase::remove_loot);
 	ClassDB::bind_method(D_METHOD("get_item", "id"), &InventoryDatabase::get_item);
+	ClassDB::bind_method(D_METHOD("get_item_handle", "id"), &InventoryDatabase::get_item_handle);
+	ClassDB::bind_method(D_METHOD("get_item_from_handle", "handle"), &InventoryDatabase::get_item_from_handle);
+	ClassDB::bind_method(D_METHOD("get_item_id_from_handle", "handle"), &InventoryDatabase::get_item_id_from_handle);
 	ClassDB::bind_method(D_METHOD("has_item_category_id", "id"), &InventoryDatabase::has_item_category_id);
 	ClassDB::bind_method(D_METHOD("has_item_id", "id"), &InventoryDatabase::has_item_id);
 	ClassDB::bind_method(D_METHOD("has_item_name", "name"), &InventoryDatabase::has_item_name);
@@ -82,6 +176,9 @@ void InventoryDatabase::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("add_new_recipe", "recipe"), &InventoryDatabase::add_new_recipe);
 	ClassDB::bind_method(D_METHOD("remove_recipe", "recipe"), &InventoryDatabase::remove_recipe);
+	ClassDB::bind_method(D_METHOD("get_recipes_for_station", "station_type_id"), &InventoryDatabase::get_recipes_for_station);
+	ClassDB::bind_method(D_METHOD("get_recipes_using_item", "item_id"), &InventoryDatabase::get_recipes_using_item);
+	ClassDB::bind_method(D_METHOD("get_recipes_producing_item", "item_id"), &InventoryDatabase::get_recipes_producing_item);
 	ClassDB::bind_method(D_METHOD("add_new_craft_station_type", "craft_station_type"), &InventoryDatabase::add_new_craft_station_type);
 	ClassDB::bind_method(D_METHOD("remove_craft_station_type", "craft_station_type"), &InventoryDatabase::remove_craft_station_type);
 
@@ -117,6 +214,7 @@ TypedArray<ItemDefinition> InventoryDatabase::get_items() const {
 
 void InventoryDatabase::set_recipes(const TypedArray<Recipe> &new_recipes) {
 	recipes = new_recipes;
+	recipes_index.indexed_size = -1;
 }
 
 TypedArray<Recipe> InventoryDatabase::get_recipes() const {
@@ -125,6 +223,7 @@ TypedArray<Recipe> InventoryDatabase::get_recipes() const {
 
 void InventoryDatabase::set_stations_type(const TypedArray<CraftStationType> &new_stations_type) {
 	stations_type = new_stations_type;
+	stations_type_index.indexed_size = -1;
 }
 
 TypedArray<CraftStationType> InventoryDatabase::get_stations_type() const {
@@ -132,6 +231,7 @@ TypedArray<CraftStationType> InventoryDatabase::get_stations_type() const {
 }
 
 void InventoryDatabase::set_item_categories(const TypedArray<ItemCategory> &new_item_categories) {
+	_release_category_indices();
 	item_categories = new_item_categories;
 	_update_items_categories_cache();
 }
@@ -142,6 +242,7 @@ TypedArray<ItemCategory> InventoryDatabase::get_item_categories() const {
 
 void InventoryDatabase::set_loots(const TypedArray<Loot> &new_loots) {
 	loots = new_loots;
+	loots_index.indexed_size = -1;
 }
 
 TypedArray<Loot> InventoryDatabase::get_loots() const {
@@ -189,6 +290,7 @@ void InventoryDatabase::remove_category(const Ref<ItemCategory> category) {
 
 	int index = item_categories.find(category);
 	if (index > -1) {
+		category->set_index(-1);
 		item_categories.remove_at(index);
 		_update_items_categories_cache();
 	}
@@ -197,6 +299,7 @@ void InventoryDatabase::remove_category(const Ref<ItemCategory> category) {
 void InventoryDatabase::add_new_loot(const Ref<Loot> loot) {
 	ERR_FAIL_NULL_MSG(loot, "'loot' is null.");
 	loots.append(loot);
+	loots_index.indexed_size = -1;
 }
 
 void InventoryDatabase::remove_loot(const Ref<Loot> loot) {
@@ -205,29 +308,52 @@ void InventoryDatabase::remove_loot(const Ref<Loot> loot) {
 	int index = loots.find(loot);
 	if (index > -1) {
 		loots.remove_at(index);
+		loots_index.indexed_size = -1;
 	}
 }
 
 Ref<ItemDefinition> InventoryDatabase::get_item(String id) const {
-	for (size_t i = 0; i < items.size(); i++) {
-		Ref<ItemDefinition> item = items[i];
-		if (item->get_id() == id)
-			return item;
+	return _find_by_id<ItemDefinition>(items, items_index, id);
+}
+
+int InventoryDatabase::get_item_handle(const String &id) const {
+	const int *handle = item_handles.getptr(StringName(id));
+	if (handle != nullptr && get_item_from_handle(*handle).is_valid())
+		return *handle;
+	Ref<ItemDefinition> item = get_item(id);
+	if (item.is_null())
+		return -1;
+	return _register_item_handle(item);
+}
+
+Ref<ItemDefinition> InventoryDatabase::get_item_from_handle(const int handle) const {
+	if (handle < 0 || handle >= (int)items_by_handle.size())
+		return nullptr;
+	const Ref<ItemDefinition> &item = items_by_handle[handle];
+	if (item.is_valid() && item->get_handle() == handle)
+		return item;
+	// The definition was removed or renamed, resolve the id again.
+	Ref<ItemDefinition> current = get_item(item_handle_ids[handle]);
+	if (current.is_null()) {
+		items_by_handle[handle] = Ref<ItemDefinition>();
+		return nullptr;
 	}
-	return nullptr;
+	items_by_handle[handle] = current;
+	current->set_handle(handle);
+	return current;
+}
+
+String InventoryDatabase::get_item_id_from_handle(const int handle) const {
+	ERR_FAIL_INDEX_V_MSG(handle, (int)item_handle_ids.size(), "", "'handle' is out of bounds.");
+	return item_handle_ids[handle];
 }
 
 bool InventoryDatabase::has_item_category_id(String id) const {
-	for (size_t i = 0; i < item_categories.size(); i++) {
-		Ref<ItemCategory> category = item_categories[i];
-		if (category->get_id() == id)
-			return true;
-	}
-	return false;
+	return get_category_from_id(id).is_valid();
 }
 
 bool InventoryDatabase::has_item_id(String id) const {
-	return items_cache.has(id);
+	return get_item(id).is_valid();
 }
 
 bool InventoryDatabase::has_item_name(String name) const {
@@ -240,21 +366,11 @@ bool InventoryDatabase::has_item_name(String name) const {
 }
 
 bool InventoryDatabase::has_craft_station_type_id(String id) const {
-	for (size_t i = 0; i < stations_type.size(); i++) {
-		Ref<CraftStationType> craft_station_type = stations_type[i];
-		if (craft_station_type->get_id() == id)
-			return true;
-	}
-	return false;
+	return get_craft_station_from_id(id).is_valid();
 }
 
 bool InventoryDatabase::has_loot_id(String id) const {
-	for (size_t i = 0; i < loots.size(); i++) {
-		Ref<Loot> loot = loots[i];
-		if (loot->get_id() == id)
-			return true;
-	}
-	return false;
+	return get_loot_from_id(id).is_valid();
 }
 
 String InventoryDatabase::get_valid_id() const {
@@ -331,6 +447,21 @@ Dictionary InventoryDatabase::serialize_item_definition(const Ref<ItemDefinition
 		data["icon"] = definition->get_icon()->get_path();
 	}
 	data["weight"] = definition->get_weight();
+	if (!definition->get_shape().is_empty()) {
+		// One string per row, cell x is the character x. Rows as numbers would lose
+		// their high bits in JSON, which stores them as doubles.
+		PackedInt64Array shape = definition->get_shape();
+		PackedStringArray shape_rows = PackedStringArray();
+		for (int y = 0; y < shape.size(); y++) {
+			uint64_t row = uint64_t(shape[y]);
+			String row_cells = String();
+			for (int x = 0; x < 64 && (row >> x) != 0; x++) {
+				row_cells += ((row >> x) & 1) != 0 ? "1" : "0";
+			}
+			shape_rows.append(row_cells);
+		}
+		data["shape"] = shape_rows;
+	}
 	if (!definition->get_properties().is_empty()) {
 		// Convert any resource references to paths for better serialization
 		data["properties"] = _convert_resources_to_paths(definition->get_properties());
@@ -369,6 +500,20 @@ void InventoryDatabase::deserialize_item_definition(Ref<ItemDefinition> definiti
 	if (data.has("weight")) {
 		definition->set_weight(data["weight"]);
 	}
+	if (data.has("shape")) {
+		PackedStringArray shape_rows = data["shape"];
+		PackedInt64Array shape = PackedInt64Array();
+		for (int y = 0; y < shape_rows.size(); y++) {
+			String row_cells = shape_rows[y];
+			uint64_t row = 0;
+			for (int x = 0; x < row_cells.length() && x < 64; x++) {
+				if (row_cells[x] == '1')
+					row |= uint64_t(1) << x;
+			}
+			shape.append(int64_t(row));
+		}
+		definition->set_shape(shape);
+	}
 	if (data.has("properties")) {
 		// Keep properties as strings (including resource paths) - don't convert to resource objects
 		definition->set_properties(data["properties"]);
@@ -381,11 +526,9 @@ void InventoryDatabase::deserialize_item_definition(Ref<ItemDefinition> definiti
 		TypedArray<String> categories_names = data["categories"];
 		for (size_t category_index = 0; category_index < categories_names.size(); category_index++) {
 			String category_id = categories_names[category_index];
-			for (size_t i = 0; i < item_categories.size(); i++) {
-				Ref<ItemCategory> category = item_categories[i];
-				if (category->get_id() == category_id) {
-					categories.append(category);
-				}
+			Ref<ItemCategory> category = get_category_from_id(category_id);
+			if (category.is_valid()) {
+				categories.append(category);
 			}
 		}
 		definition->set_categories(categories);
@@ -530,11 +673,13 @@ void InventoryDatabase::deserialize_item_stacks(TypedArray<ItemStack> item_stack
 void InventoryDatabase::add_item() {
 	Ref<ItemDefinition> definition = memnew(ItemDefinition());
 	items.append(definition);
+	_update_items_cache();
 }
 
 void InventoryDatabase::add_item_category() {
 	Ref<ItemCategory> category = memnew(ItemCategory());
 	item_categories.append(category);
+	categories_index.indexed_size = -1;
 }
 
 void InventoryDatabase::add_recipe() {
@@ -545,16 +690,23 @@ void InventoryDatabase::add_recipe() {
 void InventoryDatabase::add_craft_station_type() {
 	Ref<CraftStationType> craft_station_type = memnew(CraftStationType());
 	stations_type.append(craft_station_type);
+	stations_type_index.indexed_size = -1;
 }
 
 void InventoryDatabase::add_loot() {
 	Ref<Loot> loot = memnew(Loot());
 	loots.append(loot);
+	loots_index.indexed_size = -1;
 }
 
 void InventoryDatabase::add_new_recipe(const Ref<Recipe> recipe) {
 	ERR_FAIL_NULL_MSG(recipe, "'recipe' is null.");
+	bool is_indexed = recipes_index.indexed_size == recipes.size();
 	recipes.append(recipe);
+	if (is_indexed) {
+		_index_recipe(recipes.size() - 1);
+		recipes_index.indexed_size = recipes.size();
+	}
 }
 
 void InventoryDatabase::remove_recipe(const Ref<Recipe> recipe) {
@@ -562,13 +714,108 @@ void InventoryDatabase::remove_recipe(const Ref<Recipe> recipe) {
 	
 	int index = recipes.find(recipe);
 	if (index > -1) {
+		bool is_indexed = recipes_index.indexed_size == recipes.size();
 		recipes.remove_at(index);
+		if (is_indexed) {
+			_remove_recipe_entries(recipes_index.by_station, index);
+			_remove_recipe_entries(recipes_index.by_ingredient, index);
+			_remove_recipe_entries(recipes_index.by_product, index);
+			recipes_index.indexed_size = recipes.size();
+		}
+	}
+}
+
+void InventoryDatabase::_ensure_recipes_index() const {
+	// Recipes are edited in place from the inspector, so never trust the index there.
+	if (recipes_index.indexed_size == recipes.size() && !Engine::get_singleton()->is_editor_hint())
+		return;
+	recipes_index.by_station.clear();
+	recipes_index.by_ingredient.clear();
+	recipes_index.by_product.clear();
+	for (int i = 0; i < recipes.size(); i++) {
+		_index_recipe(i);
+	}
+	recipes_index.indexed_size = recipes.size();
+}
+
+void InventoryDatabase::_index_recipe(const int recipe_index) const {
+	Ref<Recipe> recipe = recipes[recipe_index];
+	if (recipe == nullptr)
+		return;
+	StringName station_id = recipe->get_station() != nullptr ? StringName(recipe->get_station()->get_id()) : StringName();
+	_add_recipe_entry(recipes_index.by_station, station_id, recipe_index);
+	TypedArray<ItemStack> ingredients = recipe->get_ingredients();
+	for (int i = 0; i < ingredients.size(); i++) {
+		Ref<ItemStack> stack = ingredients[i];
+		if (stack != nullptr)
+			_add_recipe_entry(recipes_index.by_ingredient, stack->get_item_id(), recipe_index);
+	}
+	TypedArray<ItemStack> required_items = recipe->get_required_items();
+	for (int i = 0; i < required_items.size(); i++) {
+		Ref<ItemStack> stack = required_items[i];
+		if (stack != nullptr)
+			_add_recipe_entry(recipes_index.by_ingredient, stack->get_item_id(), recipe_index);
+	}
+	TypedArray<ItemStack> products = recipe->get_products();
+	for (int i = 0; i < products.size(); i++) {
+		Ref<ItemStack> stack = products[i];
+		if (stack != nullptr)
+			_add_recipe_entry(recipes_index.by_product, stack->get_item_id(), recipe_index);
+	}
+}
+
+void InventoryDatabase::_add_recipe_entry(HashMap<StringName, LocalVector<int>> &entries, const StringName &key, const int recipe_index) {
+	LocalVector<int> *recipe_indices = entries.getptr(key);
+	if (recipe_indices == nullptr)
+		recipe_indices = &entries.insert(key, LocalVector<int>())->value;
+	// Recipes are indexed in order, an item listed twice in one recipe is kept once.
+	if (recipe_indices->is_empty() || (*recipe_indices)[recipe_indices->size() - 1] != recipe_index)
+		recipe_indices->push_back(recipe_index);
+}
+
+void InventoryDatabase::_remove_recipe_entries(HashMap<StringName, LocalVector<int>> &entries, const int recipe_index) {
+	for (KeyValue<StringName, LocalVector<int>> &E : entries) {
+		LocalVector<int> &recipe_indices = E.value;
+		recipe_indices.erase(recipe_index);
+		for (uint32_t i = 0; i < recipe_indices.size(); i++) {
+			if (recipe_indices[i] > recipe_index)
+				recipe_indices[i]--;
+		}
 	}
 }
 
+PackedInt32Array InventoryDatabase::_get_recipe_entries(const HashMap<StringName, LocalVector<int>> &entries, const StringName &key) {
+	PackedInt32Array result;
+	const LocalVector<int> *recipe_indices = entries.getptr(key);
+	if (recipe_indices == nullptr)
+		return result;
+	result.resize(recipe_indices->size());
+	int32_t *result_data = result.ptrw();
+	for (uint32_t i = 0; i < recipe_indices->size(); i++) {
+		result_data[i] = (*recipe_indices)[i];
+	}
+	return result;
+}
+
+PackedInt32Array InventoryDatabase::get_recipes_for_station(const String &station_type_id) const {
+	_ensure_recipes_index();
+	return _get_recipe_entries(recipes_index.by_station, station_type_id);
+}
+
+PackedInt32Array InventoryDatabase::get_recipes_using_item(const String &item_id) const {
+	_ensure_recipes_index();
+	return _get_recipe_entries(recipes_index.by_ingredient, item_id);
+}
+
+PackedInt32Array InventoryDatabase::get_recipes_producing_item(const String &item_id) const {
+	_ensure_recipes_index();
+	return _get_recipe_entries(recipes_index.by_product, item_id);
+}
+
 void InventoryDatabase::add_new_craft_station_type(const Ref<CraftStationType> craft_station_type) {
 	ERR_FAIL_NULL_MSG(craft_station_type, "'craft_station_type' is null.");
 	stations_type.append(craft_station_type);
+	stations_type_index.indexed_size = -1;
 }
 
 void InventoryDatabase::remove_craft_station_type(const Ref<CraftStationType> craft_station_type) {
@@ -577,34 +824,20 @@ void InventoryDatabase::remove_craft_station_type(const Ref<CraftStationType> cr
 	int index = stations_type.find(craft_station_type);
 	if (index > -1) {
 		stations_type.remove_at(index);
+		stations_type_index.indexed_size = -1;
 	}
 }
 
 Ref<ItemCategory> InventoryDatabase::get_category_from_id(String id) const {
-	for (size_t category_index = 0; category_index < item_categories.size(); category_index++) {
-		Ref<ItemCategory> category = item_categories[category_index];
-		if (category->get_id() == id)
-			return category;
-	}
-	return nullptr;
+	return _find_by_id<ItemCategory>(item_categories, categories_index, id);
 }
 
 Ref<CraftStationType> InventoryDatabase::get_craft_station_from_id(String id) const {
-	for (size_t i = 0; i < stations_type.size(); i++) {
-		Ref<CraftStationType> station = stations_type[i];
-		if (station->get_id() == id)
-			return station;
-	}
-	return nullptr;
+	return _find_by_id<CraftStationType>(stations_type, stations_type_index, id);
 }
 
 Ref<Loot> InventoryDatabase::get_loot_from_id(String id) const {
-	for (size_t i = 0; i < loots.size(); i++) {
-		Ref<Loot> loot = loots[i];
-		if (loot.is_valid() && loot->get_id() == id)
-			return loot;
-	}
-	return nullptr;
+	return _find_by_id<Loot>(loots, loots_index, id);
 }
 
 Dictionary InventoryDatabase::serialize() const {
@@ -631,6 +864,7 @@ void InventoryDatabase::deserialize(const Dictionary data) {
 	if (data.has("item_categories")) {
 		deserialize_item_categories(data["item_categories"]);
 	}
+	_update_items_categories_cache();
 	if (data.has("items")) {
 		deserialize_items(data["items"]);
 	}
@@ -638,6 +872,7 @@ void InventoryDatabase::deserialize(const Dictionary data) {
 	if (data.has("craft_station_types")) {
 		deserialize_craft_station_types(data["craft_station_types"]);
 	}
+	stations_type_index.indexed_size = -1;
 	if (data.has("recipes")) {
 		deserialize_recipes(data["recipes"]);
 	}
@@ -647,6 +882,7 @@ void InventoryDatabase::deserialize(const Dictionary data) {
 		// Backward compatibility with old save format
 		deserialize_loots(data["loot_tables"]);
 	}
+	loots_index.indexed_size = -1;
 }
 
 Array InventoryDatabase::serialize_items() const {
@@ -727,6 +963,7 @@ void InventoryDatabase::deserialize_recipes(Array datas) {
 		deserialize_recipe(recipe, datas[i]);
 		recipes.append(recipe);
 	}
+	recipes_index.indexed_size = -1;
 }
 
 Array InventoryDatabase::serialize_loots() const {
@@ -751,10 +988,16 @@ void InventoryDatabase::deserialize_loots(Array datas) {
 
 void InventoryDatabase::clear_current_data() {
 	items.clear();
+	_release_category_indices();
 	item_categories.clear();
 	stations_type.clear();
 	recipes.clear();
+	recipes_index.indexed_size = -1;
 	loots.clear();
+	_update_items_cache();
+	_update_items_categories_cache();
+	stations_type_index.indexed_size = -1;
+	loots_index.indexed_size = -1;
 }
 
 String InventoryDatabase::export_to_invdata() const {
@@ -3,6 +3,8 @@
 
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/classes/texture2d.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
 #include "craft_station_type.h"
 #include "item_category.h"
@@ -24,8 +26,48 @@ private:
 	Dictionary items_cache;
 	Dictionary categories_code_cache;
 
+	// Hash index from interned id to position in the owning array.
+	// Rebuilt lazily when the array size changes or a hit no longer matches.
+	struct IdIndex {
+		HashMap<StringName, int> indexes;
+		int64_t indexed_size = -1;
+	};
+	mutable IdIndex items_index;
+	mutable IdIndex categories_index;
+	mutable IdIndex stations_type_index;
+	mutable IdIndex loots_index;
+
+	// Item handles are dense and handed out per id, they are never reused
+	// while the database lives so stacks can cache them safely.
+	mutable HashMap<StringName, int> item_handles;
+	mutable LocalVector<StringName> item_handle_ids;
+	mutable LocalVector<Ref<ItemDefinition>> items_by_handle;
+
 	void _update_items_cache();
 	void _update_items_categories_cache();
+	void _release_category_indices();
+	template <typename T>
+	void _rebuild_id_index(const Array &resources, IdIndex &index) const;
+	template <typename T>
+	Ref<T> _find_by_id(const Array &resources, IdIndex &index, const String &id) const;
+	int _register_item_handle(const Ref<ItemDefinition> &item) const;
+
+	// Recipe indices by station type id (empty for recipes without a station), by item
+	// used as ingredient or required item, and by item produced, each list ascending.
+	// Rebuilt lazily when the recipes array size changes, add_new_recipe and
+	// remove_recipe keep it current.
+	struct RecipesIndex {
+		HashMap<StringName, LocalVector<int>> by_station;
+		HashMap<StringName, LocalVector<int>> by_ingredient;
+		HashMap<StringName, LocalVector<int>> by_product;
+		int64_t indexed_size = -1;
+	};
+	mutable RecipesIndex recipes_index;
+	void _ensure_recipes_index() const;
+	void _index_recipe(const int recipe_index) const;
+	static void _add_recipe_entry(HashMap<StringName, LocalVector<int>> &entries, const StringName &key, const int recipe_index);
+	static void _remove_recipe_entries(HashMap<StringName, LocalVector<int>> &entries, const int recipe_index);
+	static PackedInt32Array _get_recipe_entries(const HashMap<StringName, LocalVector<int>> &entries, const StringName &key);
 
 protected:
 	static void _bind_methods();
@@ -55,6 +97,9 @@ public:
 	void add_new_loot(const Ref<Loot> loot);
 	void remove_loot(const Ref<Loot> loot);
 	Ref<ItemDefinition> get_item(String id) const;
+	int get_item_handle(const String &id) const;
+	Ref<ItemDefinition> get_item_from_handle(const int handle) const;
+	String get_item_id_from_handle(const int handle) const;
 	bool has_item_category_id(String id) const;
 	bool has_item_id(String id) const;
 	bool has_item_name(String name) const;
@@ -91,6 +136,9 @@ public:
 
 	void add_new_recipe(const Ref<Recipe> recipe);
 	void remove_recipe(const Ref<Recipe> recipe);
+	PackedInt32Array get_recipes_for_station(const String &station_type_id) const;
+	PackedInt32Array get_recipes_using_item(const String &item_id) const;
+	PackedInt32Array get_recipes_producing_item(const String &item_id) const;
 	void add_new_craft_station_type(const Ref<CraftStationType> craft_station_type);
 	void remove_craft_station_type(const Ref<CraftStationType> craft_station_type);
 
@@ -19,6 +19,7 @@ void ItemCategory::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_item_dynamic_properties", "item_dynamic_properties"), &ItemCategory::set_item_dynamic_properties);
 	ClassDB::bind_method(D_METHOD("get_item_dynamic_properties"), &ItemCategory::get_item_dynamic_properties);
 	ClassDB::bind_method(D_METHOD("get_code"), &ItemCategory::get_code);
+	ClassDB::bind_method(D_METHOD("get_index"), &ItemCategory::get_index);
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "id"), "set_id", "get_id");
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "name"), "set_name", "get_name");
 	ADD_PROPERTY(PropertyInfo(Variant::COLOR, "color"), "set_color", "get_color");
@@ -27,6 +28,8 @@ void ItemCategory::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "item_dynamic_properties", PROPERTY_HINT_ARRAY_TYPE, "String"), "set_item_dynamic_properties", "get_item_dynamic_properties");
 }
 
+uint64_t ItemCategory::index_revision = 0;
+
 ItemCategory::ItemCategory() {
 }
 
@@ -75,6 +78,20 @@ int ItemCategory::get_code() const {
 	return code;
 }
 
+void ItemCategory::set_index(const int &new_index) {
+	if (index != new_index)
+		index_revision++;
+	index = new_index;
+}
+
+int ItemCategory::get_index() const {
+	return index;
+}
+
+uint64_t ItemCategory::get_index_revision() {
+	return index_revision;
+}
+
 void ItemCategory::set_item_properties(const Dictionary &new_item_properties) {
 	item_properties = new_item_properties;
 }
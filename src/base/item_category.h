@@ -15,6 +15,9 @@ private:
 	Color color;
 	Ref<Texture2D> icon;
 	int code = 0;
+	// Bit of the category in ItemDefinition category sets, -1 outside a database.
+	int index = -1;
+	static uint64_t index_revision;
 	Dictionary item_properties;
 	TypedArray<String> item_dynamic_properties;
 
@@ -34,6 +37,10 @@ public:
 	Ref<Texture2D> get_icon() const;
 	void set_code(const int &new_code);
 	int get_code() const;
+	void set_index(const int &new_index);
+	int get_index() const;
+	// Bumped when any category changes index, inventories keying totals by index rebuild them.
+	static uint64_t get_index_revision();
 	void set_item_properties(const Dictionary &new_item_properties);
 	Dictionary get_item_properties() const;
 	void set_item_dynamic_properties(const TypedArray<String> &new_item_dynamic_properties);
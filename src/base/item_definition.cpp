@@ -30,6 +30,11 @@ void ItemDefinition::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_weight"), &ItemDefinition::get_weight);
 	ClassDB::bind_method(D_METHOD("set_size", "size"), &ItemDefinition::set_size);
 	ClassDB::bind_method(D_METHOD("get_size"), &ItemDefinition::get_size);
+	ClassDB::bind_method(D_METHOD("set_shape", "shape"), &ItemDefinition::set_shape);
+	ClassDB::bind_method(D_METHOD("get_shape"), &ItemDefinition::get_shape);
+	ClassDB::bind_method(D_METHOD("has_shape"), &ItemDefinition::has_shape);
+	ClassDB::bind_method(D_METHOD("get_shape_rows", "is_rotated"), &ItemDefinition::get_shape_rows, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("is_cell_in_shape", "cell", "is_rotated"), &ItemDefinition::is_cell_in_shape, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("set_properties", "properties"), &ItemDefinition::set_properties);
 	ClassDB::bind_method(D_METHOD("get_properties"), &ItemDefinition::get_properties);
 	ClassDB::bind_method(D_METHOD("set_dynamic_properties", "dynamic_properties"), &ItemDefinition::set_dynamic_properties);
@@ -47,12 +52,15 @@ void ItemDefinition::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "icon", PROPERTY_HINT_RESOURCE_TYPE, "Texture2D"), "set_icon", "get_icon");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "weight"), "set_weight", "get_weight");
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR2I, "size"), "set_size", "get_size");
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_INT64_ARRAY, "shape"), "set_shape", "get_shape");
 	ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "properties"), "set_properties", "get_properties");
 	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "dynamic_properties", PROPERTY_HINT_ARRAY_TYPE, "String"), "set_dynamic_properties", "get_dynamic_properties");
 	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "categories", PROPERTY_HINT_ARRAY_TYPE, vformat("%s/%s:%s", Variant::OBJECT, PROPERTY_HINT_RESOURCE_TYPE, "ItemCategory")), "set_categories", "get_categories");
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "description"), "set_description", "get_description");
 }
 
+uint64_t ItemDefinition::cache_revision = 0;
+
 ItemDefinition::ItemDefinition() {
 }
 
@@ -62,6 +70,9 @@ ItemDefinition::~ItemDefinition() {
 // Properties
 
 void ItemDefinition::set_id(const String &new_id) {
+	if (id != new_id) {
+		handle = -1;
+	}
 	id = new_id;
 }
 
@@ -71,6 +82,7 @@ String ItemDefinition::get_id() const {
 
 void ItemDefinition::set_can_stack(const bool &new_can_stack) {
 	can_stack = new_can_stack;
+	cache_revision++;
 }
 
 bool ItemDefinition::get_can_stack() const {
@@ -87,6 +99,7 @@ String ItemDefinition::get_name() const {
 
 void ItemDefinition::set_max_stack(const int &new_max_stack) {
 	max_stack = new_max_stack;
+	cache_revision++;
 }
 
 int ItemDefinition::get_max_stack() const {
@@ -107,6 +120,7 @@ Ref<Texture2D> ItemDefinition::get_icon() const {
 
 void ItemDefinition::set_weight(const float &new_weight) {
 	weight = new_weight;
+	cache_revision++;
 }
 
 float ItemDefinition::get_weight() const {
@@ -119,12 +133,71 @@ void ItemDefinition::set_size(const Vector2i &new_size) {
 		size = Vector2i(1, size.y);
 	if(size.y <= 0)
 		size = Vector2i(size.x, 1);
+	_update_shape_rows();
 }
 
 Vector2i ItemDefinition::get_size() const {
 	return size;
 }
 
+void ItemDefinition::_update_shape_rows() {
+	shape_rows.clear();
+	rotated_shape_rows.clear();
+	if (shape.is_empty())
+		return;
+	ERR_FAIL_COND_MSG(size.x > 64 || size.y > 64, "Item shapes only support sizes up to 64x64, the item is used as a rectangle.");
+	uint64_t full_row = size.x == 64 ? ~uint64_t(0) : (uint64_t(1) << size.x) - 1;
+	bool is_rectangle = true;
+	shape_rows.resize(size.y);
+	for (int y = 0; y < size.y; y++) {
+		uint64_t row = y < shape.size() ? uint64_t(shape[y]) & full_row : 0;
+		shape_rows.set(y, int64_t(row));
+		if (row != full_row)
+			is_rectangle = false;
+	}
+	if (is_rectangle) {
+		shape_rows.clear();
+		return;
+	}
+	// A quarter turn clockwise takes cell (x, y) to (size.y - 1 - y, x).
+	rotated_shape_rows.resize(size.x);
+	for (int x = 0; x < size.x; x++) {
+		uint64_t row = 0;
+		for (int y = 0; y < size.y; y++) {
+			if ((uint64_t(shape_rows[y]) >> x) & 1)
+				row |= uint64_t(1) << (size.y - 1 - y);
+		}
+		rotated_shape_rows.set(x, int64_t(row));
+	}
+}
+
+void ItemDefinition::set_shape(const PackedInt64Array &new_shape) {
+	shape = new_shape;
+	_update_shape_rows();
+}
+
+PackedInt64Array ItemDefinition::get_shape() const {
+	return shape;
+}
+
+bool ItemDefinition::has_shape() const {
+	return !shape_rows.is_empty();
+}
+
+PackedInt64Array ItemDefinition::get_shape_rows(const bool is_rotated) const {
+	return is_rotated ? rotated_shape_rows : shape_rows;
+}
+
+bool ItemDefinition::is_cell_in_shape(const Vector2i &cell, const bool is_rotated) const {
+	Vector2i footprint = is_rotated ? get_rotated_size() : size;
+	if (cell.x < 0 || cell.y < 0 || cell.x >= footprint.x || cell.y >= footprint.y)
+		return false;
+	if (shape_rows.is_empty())
+		return true;
+	const PackedInt64Array &rows = is_rotated ? rotated_shape_rows : shape_rows;
+	return (uint64_t(rows[cell.y]) >> cell.x) & 1;
+}
+
 void ItemDefinition::set_properties(const Dictionary &new_properties) {
 	properties = new_properties;
 	_check_invalid_dynamic_properties();
@@ -144,6 +217,7 @@ TypedArray<String> ItemDefinition::get_dynamic_properties() const {
 
 void ItemDefinition::set_categories(const TypedArray<ItemCategory> &new_categories) {
 	categories = new_categories;
+	cache_revision++;
 	Dictionary properties = get_properties();
 	Array dynamic_properties = get_dynamic_properties();
 	for (size_t i = 0; i < categories.size(); i++) {
@@ -160,6 +234,7 @@ void ItemDefinition::set_categories(const TypedArray<ItemCategory> &new_categori
 			}
 		}
 	}
+	update_category_bits();
 }
 
 TypedArray<ItemCategory> ItemDefinition::get_categories() const {
@@ -169,6 +244,11 @@ TypedArray<ItemCategory> ItemDefinition::get_categories() const {
 bool ItemDefinition::is_in_category(const Ref<ItemCategory> category) const {
 	ERR_FAIL_NULL_V_MSG(category, false, "'category' is null.");
 
+	int index = category->get_index();
+	if (has_category_bits && index >= 0) {
+		uint32_t word = index >> 6;
+		return word < category_bits.size() && ((category_bits[word] >> (index & 63)) & 1) != 0;
+	}
 	for (size_t i = 0; i < categories.size(); i++) {
 		Ref<ItemCategory> c = categories[i];
 		if (c == category) {
@@ -178,6 +258,30 @@ bool ItemDefinition::is_in_category(const Ref<ItemCategory> category) const {
 	return false;
 }
 
+void ItemDefinition::update_category_bits() {
+	category_bits.clear();
+	has_category_bits = true;
+	for (size_t i = 0; i < categories.size(); i++) {
+		Ref<ItemCategory> category = categories[i];
+		if (category == nullptr)
+			continue;
+		int index = category->get_index();
+		if (index < 0) {
+			has_category_bits = false;
+			return;
+		}
+		uint32_t word = index >> 6;
+		if (word >= category_bits.size()) {
+			uint32_t old_size = category_bits.size();
+			category_bits.resize(word + 1);
+			for (uint32_t w = old_size; w < category_bits.size(); w++) {
+				category_bits[w] = 0;
+			}
+		}
+		category_bits[word] |= uint64_t(1) << (index & 63);
+	}
+}
+
 Vector2i ItemDefinition::get_rotated_size() const {
 	return Vector2i(size.y, size.x);
 }
@@ -189,3 +293,15 @@ void ItemDefinition::set_description(const String &new_description) {
 String ItemDefinition::get_description() const {
     return description;
 }
+
+void ItemDefinition::set_handle(const int &new_handle) {
+	handle = new_handle;
+}
+
+int ItemDefinition::get_handle() const {
+	return handle;
+}
+
+uint64_t ItemDefinition::get_cache_revision() {
+	return cache_revision;
+}
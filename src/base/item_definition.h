@@ -3,6 +3,7 @@
 
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/classes/texture2d.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
 #include "item_category.h"
 
@@ -19,11 +20,24 @@ private:
 	Ref<Texture2D> icon;
 	float weight = 0.0;
 	Vector2i size = Vector2i(1, 1);
+	// Cells the item takes inside its size, one row per word with bit x for column x.
+	// Empty for rectangular items. The rows clipped to the size and turned a quarter
+	// clockwise for rotated stacks are cached, both are empty when every cell is taken.
+	PackedInt64Array shape;
+	PackedInt64Array shape_rows;
+	PackedInt64Array rotated_shape_rows;
 	String description = ""; // <-- added
 	Dictionary properties;
 	TypedArray<String> dynamic_properties;
 	TypedArray<ItemCategory> categories;
+	// One bit per category index, so membership is a single word test. Only used
+	// while every category has an index, the categories are walked otherwise.
+	LocalVector<uint64_t> category_bits;
+	bool has_category_bits = false;
+	int handle = -1;
+	static uint64_t cache_revision;
 	void _check_invalid_dynamic_properties();
+	void _update_shape_rows();
 
 protected:
 	static void _bind_methods();
@@ -45,6 +59,11 @@ public:
 	float get_weight() const;
 	void set_size(const Vector2i &new_size);
 	Vector2i get_size() const;
+	void set_shape(const PackedInt64Array &new_shape);
+	PackedInt64Array get_shape() const;
+	bool has_shape() const;
+	PackedInt64Array get_shape_rows(const bool is_rotated = false) const;
+	bool is_cell_in_shape(const Vector2i &cell, const bool is_rotated = false) const;
 	void set_properties(const Dictionary &new_properties);
 	Dictionary get_properties() const;
 	void set_dynamic_properties(const TypedArray<String> &new_dynamic_properties);
@@ -52,9 +71,17 @@ public:
 	void set_categories(const TypedArray<ItemCategory> &new_categories);
 	TypedArray<ItemCategory> get_categories() const;
 	bool is_in_category(const Ref<ItemCategory> category) const;
+	// Called by the database whenever it renumbers its categories.
+	void update_category_bits();
 	Vector2i get_rotated_size() const;
 	void set_description(const String &new_description);
 	String get_description() const;
+	// Dense runtime handle assigned by the InventoryDatabase, -1 when unassigned.
+	void set_handle(const int &new_handle);
+	int get_handle() const;
+	// Bumped when a field inventories keep per item (weight, max stack, categories) changes
+	// on any definition, their totals are rebuilt when it moved.
+	static uint64_t get_cache_revision();
 };
 
 #endif
\ No newline at end of file
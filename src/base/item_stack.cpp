@@ -27,7 +27,11 @@ ItemStack::~ItemStack() {
 }
 
 void ItemStack::set_item_id(const String &new_item_id) {
+	if (item_id != new_item_id) {
+		item_handle = -1;
+	}
 	item_id = new_item_id;
+	emit_changed();
 	emit_signal("updated");
 }
 
@@ -35,8 +39,17 @@ String ItemStack::get_item_id() const {
 	return item_id;
 }
 
+void ItemStack::set_item_handle(const int &new_item_handle) {
+	item_handle = new_item_handle;
+}
+
+int ItemStack::get_item_handle() const {
+	return item_handle;
+}
+
 void ItemStack::set_amount(const int &new_amount) {
 	amount = new_amount;
+	emit_changed();
 	emit_signal("updated");
 }
 
@@ -46,6 +59,7 @@ int ItemStack::get_amount() const {
 
 void ItemStack::set_properties(const Dictionary &new_properties) {
 	properties = new_properties;
+	emit_changed();
 	emit_signal("updated");
 }
 
@@ -53,6 +67,15 @@ Dictionary ItemStack::get_properties() const {
 	return properties;
 }
 
+void ItemStack::set_content(const String &new_item_id, const int new_item_handle, const int new_amount, const Dictionary &new_properties, const bool emit_updated) {
+	item_id = new_item_id;
+	item_handle = new_item_handle;
+	amount = new_amount;
+	properties = new_properties;
+	if (emit_updated)
+		emit_signal("updated");
+}
+
 Array ItemStack::serialize() const {
 	Array data = Array();
 	data.append(item_id);
@@ -10,6 +10,7 @@ class ItemStack : public Resource {
 
 private:
 	String item_id = "";
+	int item_handle = -1;
 	int amount = 0;
 	Dictionary properties;
 
@@ -21,10 +22,17 @@ public:
 	~ItemStack();
 	void set_item_id(const String &new_item_id);
 	String get_item_id() const;
+	// Database handle of item_id, cached by inventories. -1 when unresolved.
+	void set_item_handle(const int &new_item_handle);
+	int get_item_handle() const;
 	void set_amount(const int &new_amount);
 	int get_amount() const;
 	void set_properties(const Dictionary &new_properties);
 	Dictionary get_properties() const;
+	// Sets every field at once with a single 'updated' emission, or none if emit_updated is false.
+	// Unlike the setters scripts and the inspector use, it does not emit 'changed', which
+	// inventories holding the stack listen to for edits made behind their back.
+	void set_content(const String &new_item_id, const int new_item_handle, const int new_amount, const Dictionary &new_properties, const bool emit_updated = true);
 	Array serialize() const;
 	void deserialize(Array data);
 	bool contains(const String &item_id, const int amount = 1) const;
@@ -1,7 +1,10 @@
 #include "grid_inventory_constraint.h"
+#include "core/grid_inventory.h"
 
 void GridInventoryConstraint::_bind_methods() {
     GDVIRTUAL_BIND(_can_add_on_position, "inventory", "position", "item_id", "amount", "properties", "is_rotated");
+    GDVIRTUAL_BIND(_is_position_static, "inventory", "item_id");
+    GDVIRTUAL_BIND(_get_allowed_positions, "inventory", "item_id", "is_rotated");
 }
 
 GridInventoryConstraint::GridInventoryConstraint() {
@@ -16,4 +19,33 @@ bool GridInventoryConstraint::can_add_on_position(const Node* inventory_node, co
 		return ret;
 	}
 	return true;
+}
+
+bool GridInventoryConstraint::is_position_static(const Node* inventory_node, const String item_id) {
+    bool ret;
+    if (GDVIRTUAL_CALL(_is_position_static, inventory_node, item_id, ret)) {
+		return ret;
+	}
+	return false;
+}
+
+PackedInt64Array GridInventoryConstraint::get_allowed_positions(const Node* inventory_node, const String item_id, const bool is_rotated) {
+    PackedInt64Array ret;
+    if (GDVIRTUAL_CALL(_get_allowed_positions, inventory_node, item_id, is_rotated, ret)) {
+		return ret;
+	}
+	// Not overridden, ask every cell once.
+	const GridInventory *inventory = Object::cast_to<GridInventory>(inventory_node);
+	ERR_FAIL_NULL_V_MSG(inventory, ret, "'inventory' is not a GridInventory.");
+	Vector2i size = inventory->get_size();
+	ret.resize(size.y);
+	for (int y = 0; y < size.y; y++) {
+		uint64_t row = 0;
+		for (int x = 0; x < size.x && x < 64; x++) {
+			if (can_add_on_position(inventory_node, Vector2i(x, y), item_id, 1, Dictionary(), is_rotated))
+				row |= uint64_t(1) << x;
+		}
+		ret.set(y, int64_t(row));
+	}
+	return ret;
 }
\ No newline at end of file
@@ -21,7 +21,11 @@ public:
 	GridInventoryConstraint();
 	~GridInventoryConstraint();
 	virtual bool can_add_on_position(const Node* inventory_node, const Vector2i position, const String item_id, const int amount, const Dictionary properties, const bool is_rotated);
+	virtual bool is_position_static(const Node* inventory_node, const String item_id);
+	virtual PackedInt64Array get_allowed_positions(const Node* inventory_node, const String item_id, const bool is_rotated);
 	GDVIRTUAL6R(bool, _can_add_on_position, const Node*, Vector2i, String, int, Dictionary, bool);
+	GDVIRTUAL2R(bool, _is_position_static, const Node*, String);
+	GDVIRTUAL3R(PackedInt64Array, _get_allowed_positions, const Node*, String, bool);
 
 };
 
@@ -1,28 +1,713 @@
 #include "grid_inventory.h"
 #include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline int _count_trailing_zeros(const uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return (int)index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+static inline int _count_set_bits(const uint64_t value) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(value);
+#else
+	return __builtin_popcountll(value);
+#endif
+}
 
 void GridInventory::_enter_tree() {
 	_refresh_quad_tree();
 }
 
 bool GridInventory::_bounds_broken() const {
-	for (size_t i = 0; i < get_stacks().size(); i++) {
-		Ref<ItemStack> stack = get_stacks()[i];
-		if (!rect_free(get_stack_rect(stack), stack))
+	_ensure_placements();
+	for (uint32_t i = 0; i < placements.size(); i++) {
+		const StackPlacement &placement = placements[i];
+		if (!_footprint_free(placement.position, placement.size, placement.shape, stacks[i]))
 			return true;
 	}
 	return false;
 }
 
 void GridInventory::_refresh_quad_tree() {
-	Ref<QuadTree> new_quad_tree = memnew(QuadTree());
-	new_quad_tree->init(size);
-	set_quad_tree(new_quad_tree);
-	for (size_t i = 0; i < get_stacks().size(); i++) {
-		Ref<ItemStack> stack = get_stacks()[i];
-		quad_tree->add(get_stack_rect(stack), stack);
+	if (quad_tree == nullptr) {
+		Ref<QuadTree> new_quad_tree = memnew(QuadTree());
+		set_quad_tree(new_quad_tree);
+	}
+	quad_tree->init(size);
+	_rebuild_grid();
+}
+
+void GridInventory::_rebuild_grid() {
+	// Bulk loads the quad tree and the occupancy from the placements.
+	_reset_occupancy();
+	_ensure_placements();
+	LocalVector<Rect2i> rects;
+	LocalVector<Variant> metadatas;
+	rects.reserve(stacks.size());
+	metadatas.reserve(stacks.size());
+	for (uint32_t i = 0; i < placements.size(); i++) {
+		const StackPlacement &placement = placements[i];
+		if (placement.stack == nullptr)
+			continue;
+		Rect2i rect = Rect2i(placement.position, placement.size);
+		rects.push_back(rect);
+		metadatas.push_back(stacks[i]);
+		_set_footprint_occupancy(rect, placement.shape, true);
+	}
+	quad_tree->build_from(rects, metadatas);
+	free_rects_dirty = true;
+	grid_version++;
+}
+
+void GridInventory::_reset_occupancy() {
+	memset(occupancy, 0, sizeof(occupancy));
+	chunked = size.x > 64 || size.y > 64;
+	row_words = (size.x + 63) / 64;
+	tiles.reset();
+	free_tile = -1;
+	tile_table.reset();
+	if (!chunked)
+		return;
+	tile_table.resize(row_words * ((size.y + 63) / 64));
+	for (uint32_t i = 0; i < tile_table.size(); i++) {
+		tile_table[i] = -1;
+	}
+}
+
+int GridInventory::_alloc_tile() {
+	if (free_tile == -1) {
+		tiles.push_back(OccupancyTile());
+		return tiles.size() - 1;
+	}
+	int tile_index = free_tile;
+	free_tile = tiles[tile_index].next_free;
+	tiles[tile_index] = OccupancyTile();
+	return tile_index;
+}
+
+void GridInventory::_free_tile(const int tile_index) {
+	tiles[tile_index].next_free = free_tile;
+	free_tile = tile_index;
+}
+
+uint64_t GridInventory::_get_occupancy_word(const int y, const int word) const {
+	if (!chunked)
+		return word == 0 ? occupancy[y] : 0;
+	int tile_index = tile_table[(y >> 6) * row_words + word];
+	return tile_index == -1 ? 0 : tiles[tile_index].rows[y & 63];
+}
+
+bool GridInventory::_is_tile_full(const int y, const int word) const {
+	if (!chunked)
+		return false;
+	int tile_index = tile_table[(y >> 6) * row_words + word];
+	if (tile_index == -1)
+		return false;
+	int tile_y = y & ~63;
+	int capacity = MIN(64, size.x - word * 64) * MIN(64, size.y - tile_y);
+	return tiles[tile_index].used_cells == capacity;
+}
+
+int GridInventory::_get_free_cells() const {
+	int used_cells = 0;
+	if (!chunked) {
+		for (int y = 0; y < size.y; y++) {
+			used_cells += _count_set_bits(occupancy[y]);
+		}
+	} else {
+		for (uint32_t i = 0; i < tile_table.size(); i++) {
+			if (tile_table[i] != -1)
+				used_cells += tiles[tile_table[i]].used_cells;
+		}
+	}
+	return size.x * size.y - used_cells;
+}
+
+void GridInventory::_copy_occupancy(LocalVector<uint64_t> &r_rows) const {
+	r_rows.resize(size.y * row_words);
+	for (int y = 0; y < size.y; y++) {
+		for (int word = 0; word < row_words; word++) {
+			r_rows[y * row_words + word] = _get_occupancy_word(y, word);
+		}
+	}
+}
+
+uint64_t GridInventory::_get_row_mask(const int x, const int width) {
+	if (width <= 0)
+		return 0;
+	if (width >= 64)
+		return ~uint64_t(0);
+	return ((uint64_t(1) << width) - 1) << x;
+}
+
+uint64_t GridInventory::_get_word_mask(const int word, const int x, const int width) {
+	// Part of the columns x .. x + width - 1 that falls in the word.
+	int word_x = word * 64;
+	int begin = MAX(x, word_x);
+	int end = MIN(x + width, word_x + 64);
+	return end > begin ? _get_row_mask(begin - word_x, end - begin) : 0;
+}
+
+uint64_t GridInventory::_get_start_candidates(const uint64_t free_columns, const uint64_t next_free_columns, const uint64_t start_columns, const int width) {
+	// A bit x survives when columns x .. x + width - 1 are all free, the last ones
+	// may fall in the next word. Wider spans go through _get_span_start_candidates.
+	uint64_t candidates = free_columns & start_columns;
+	for (int offset = 1; offset < width && candidates != 0; offset++) {
+		candidates &= (free_columns >> offset) | (next_free_columns << (64 - offset));
+	}
+	return candidates;
+}
+
+uint64_t GridInventory::_get_span_start_candidates(const uint64_t *free_words, const int word_count, const int word, const int width) {
+	// Checked 64 columns at a time, the next 64 columns of a start in the word are the
+	// columns of the same start bit in the following word.
+	uint64_t candidates = ~uint64_t(0);
+	for (int part_word = word, remaining = width; remaining > 0 && candidates != 0; part_word++, remaining -= 64) {
+		uint64_t free_columns = part_word < word_count ? free_words[part_word] : 0;
+		uint64_t next_free_columns = part_word + 1 < word_count ? free_words[part_word + 1] : 0;
+		candidates = _get_start_candidates(free_columns, next_free_columns, candidates, MIN(remaining, 64));
+	}
+	return candidates;
+}
+
+uint64_t GridInventory::_get_shape_start_candidates(const uint64_t free_columns, const uint64_t next_free_columns, const uint64_t start_columns, const uint64_t shape_row) {
+	// A bit x survives when column x + b is free for every bit b of the shape row.
+	uint64_t candidates = start_columns;
+	uint64_t offsets = shape_row;
+	while (offsets != 0 && candidates != 0) {
+		int offset = _count_trailing_zeros(offsets);
+		offsets &= offsets - 1;
+		candidates &= offset == 0 ? free_columns : (free_columns >> offset) | (next_free_columns << (64 - offset));
+	}
+	return candidates;
+}
+
+uint64_t GridInventory::_get_shifted_word(const uint64_t bits, const int x, const int word) {
+	// Part of a row of bits starting at column x that falls in the word.
+	int offset = x - word * 64;
+	if (offset >= 64 || offset <= -64)
+		return 0;
+	return offset >= 0 ? bits << offset : bits >> -offset;
+}
+
+uint64_t GridInventory::_get_start_columns(const int word, const int width) const {
+	// Columns where a stack of this width can start without leaving the grid.
+	return _get_word_mask(word, 0, size.x - width + 1);
+}
+
+void GridInventory::_set_occupancy(const Rect2i &rect, const bool occupied) {
+	Rect2i clipped = rect.intersection(Rect2i(Vector2i(0, 0), size));
+	if (clipped.size.x <= 0 || clipped.size.y <= 0)
+		return;
+	if (!chunked) {
+		uint64_t mask = _get_row_mask(clipped.position.x, clipped.size.x);
+		for (int y = clipped.position.y; y < clipped.position.y + clipped.size.y; y++) {
+			if (occupied) {
+				occupancy[y] |= mask;
+			} else {
+				occupancy[y] &= ~mask;
+			}
+		}
+		return;
+	}
+	int first_word = clipped.position.x >> 6;
+	int last_word = (clipped.position.x + clipped.size.x - 1) >> 6;
+	for (int y = clipped.position.y; y < clipped.position.y + clipped.size.y; y++) {
+		for (int word = first_word; word <= last_word; word++) {
+			_set_occupancy_word(y, word, _get_word_mask(word, clipped.position.x, clipped.size.x), occupied);
+		}
+	}
+}
+
+void GridInventory::_set_occupancy_word(const int y, const int word, const uint64_t mask, const bool occupied) {
+	if (!chunked) {
+		if (occupied) {
+			occupancy[y] |= mask;
+		} else {
+			occupancy[y] &= ~mask;
+		}
+		return;
+	}
+	int &tile_index = tile_table[(y >> 6) * row_words + word];
+	if (tile_index == -1) {
+		if (!occupied)
+			return;
+		tile_index = _alloc_tile();
+	}
+	OccupancyTile &tile = tiles[tile_index];
+	uint64_t &row = tile.rows[y & 63];
+	uint64_t changed = occupied ? (mask & ~row) : (mask & row);
+	row ^= changed;
+	tile.used_cells += occupied ? _count_set_bits(changed) : -_count_set_bits(changed);
+	if (tile.used_cells == 0) {
+		_free_tile(tile_index);
+		tile_index = -1;
+	}
+}
+
+void GridInventory::_set_footprint_occupancy(const Rect2i &rect, const PackedInt64Array &shape, const bool occupied) {
+	if (shape.is_empty()) {
+		_set_occupancy(rect, occupied);
+		return;
+	}
+	int first_word = MAX(rect.position.x >> 6, 0);
+	int last_word = MIN((rect.position.x + rect.size.x - 1) >> 6, row_words - 1);
+	for (int row = 0; row < rect.size.y && row < shape.size(); row++) {
+		int y = rect.position.y + row;
+		if (y < 0 || y >= size.y)
+			continue;
+		for (int word = first_word; word <= last_word; word++) {
+			uint64_t mask = _get_shifted_word(uint64_t(shape[row]), rect.position.x, word) & _get_word_mask(word, 0, size.x);
+			if (mask != 0)
+				_set_occupancy_word(y, word, mask, occupied);
+		}
+	}
+}
+
+uint64_t GridInventory::_get_blocked_columns(const int y, const int height, const int word, const StackException &exception) const {
+	// Stacks never overlap, so the cells of the exception belong to it alone.
+	const Rect2i &exception_rect = exception.rect;
+	uint64_t exception_mask = _get_word_mask(word, exception_rect.position.x, exception_rect.size.x);
+	uint64_t blocked = 0;
+	for (int row = y; row < y + height; row++) {
+		uint64_t row_occupancy = chunked ? _get_occupancy_word(row, word) : occupancy[row];
+		if (row >= exception_rect.position.y && row < exception_rect.position.y + exception_rect.size.y) {
+			if (!exception.shape.is_empty())
+				exception_mask = _get_shifted_word(uint64_t(exception.shape[row - exception_rect.position.y]), exception_rect.position.x, word);
+			row_occupancy &= ~exception_mask;
+		}
+		blocked |= row_occupancy;
+	}
+	return blocked;
+}
+
+void GridInventory::_get_free_words(const int y, const int height, const StackException &exception, LocalVector<uint64_t> &r_free_words) const {
+	r_free_words.resize(row_words);
+	for (int word = 0; word < row_words; word++) {
+		r_free_words[word] = ~_get_blocked_columns(y, height, word, exception);
+	}
+}
+
+GridInventory::StackException GridInventory::_get_exception(const Ref<ItemStack> &exception) const {
+	StackException result;
+	int stack_index = _get_placement_index(exception);
+	if (stack_index == -1)
+		return result;
+	const StackPlacement &placement = placements[stack_index];
+	result.rect = Rect2i(placement.position, placement.size);
+	result.shape = placement.shape;
+	return result;
+}
+
+bool GridInventory::_footprint_free(const Vector2i &position, const Vector2i &footprint_size, const PackedInt64Array &shape, const Ref<ItemStack> &exception) const {
+	if (shape.is_empty())
+		return rect_free(Rect2i(position, footprint_size), exception);
+	if (position.x < 0 || position.y < 0 || footprint_size.x < 1 || footprint_size.y < 1)
+		return false;
+	if (position.x + footprint_size.x > size.x || position.y + footprint_size.y > size.y)
+		return false;
+	// Each shape row shifted to the position against the occupancy row under it.
+	StackException stack_exception = _get_exception(exception);
+	int last_word = (position.x + footprint_size.x - 1) >> 6;
+	for (int row = 0; row < footprint_size.y && row < shape.size(); row++) {
+		for (int word = position.x >> 6; word <= last_word; word++) {
+			uint64_t cells = _get_shifted_word(uint64_t(shape[row]), position.x, word);
+			if (cells != 0 && (_get_blocked_columns(position.y + row, 1, word, stack_exception) & cells) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+void GridInventory::_invalidate_item_stacks_index() {
+	Inventory::_invalidate_item_stacks_index();
+	placements_dirty = true;
+}
+
+void GridInventory::_rebuild_placements() const {
+	placements.resize(stacks.size());
+	placement_indices.clear();
+	placement_indices.reserve(stacks.size());
+	for (int i = 0; i < stacks.size(); i++) {
+		Vector2i position = i < stack_positions.size() ? Vector2i(stack_positions[i]) : Vector2i();
+		bool is_rotated = i < stack_rotations.size() ? bool(stack_rotations[i]) : false;
+		_fill_placement(i, position, is_rotated);
 	}
+	placements_dirty = false;
+}
+
+void GridInventory::_fill_placement(const int stack_index, const Vector2i &position, const bool is_rotated) const {
+	Ref<ItemStack> stack = stacks[stack_index];
+	StackPlacement &placement = placements[stack_index];
+	placement.stack = stack.ptr();
+	placement.position = position;
+	placement.rotated = is_rotated;
+	placement.size = stack != nullptr ? _get_footprint(stack->get_item_id(), is_rotated) : Vector2i();
+	placement.shape = stack != nullptr ? _get_footprint_shape(stack->get_item_id(), is_rotated) : PackedInt64Array();
+	if (stack != nullptr)
+		placement_indices.insert(stack.ptr(), stack_index);
+}
+
+void GridInventory::_load_placements(const PackedVector2iArray &positions, const PackedByteArray &rotations) {
+	int count = stacks.size();
+	stack_positions.resize(count);
+	stack_rotations.resize(count);
+	placements.resize(count);
+	placement_indices.clear();
+	placement_indices.reserve(count);
+	const Vector2i *position_data = positions.ptr();
+	const uint8_t *rotation_data = rotations.ptr();
+	for (int i = 0; i < count; i++) {
+		Vector2i position = i < positions.size() ? position_data[i] : Vector2i();
+		bool is_rotated = (i >> 3) < rotations.size() && ((rotation_data[i >> 3] >> (i & 7)) & 1) != 0;
+		stack_positions[i] = position;
+		stack_rotations[i] = is_rotated;
+		_fill_placement(i, position, is_rotated);
+	}
+	placements_dirty = false;
+}
+
+void GridInventory::_ensure_placements() const {
+	if (placements_dirty || placements.size() != stacks.size() || stack_positions.size() != stacks.size())
+		_rebuild_placements();
+}
+
+int GridInventory::_get_placement_index(const Ref<ItemStack> &stack) const {
+	if (stack == nullptr)
+		return -1;
+	_ensure_placements();
+	const int *stack_index = placement_indices.getptr(stack.ptr());
+	if (stack_index == nullptr)
+		return -1;
+	if (placements[*stack_index].stack != Ref<ItemStack>(stacks[*stack_index]).ptr()) {
+		_rebuild_placements();
+		stack_index = placement_indices.getptr(stack.ptr());
+		if (stack_index == nullptr)
+			return -1;
+	}
+	return *stack_index;
+}
+
+Vector2i GridInventory::_get_footprint(const String &item_id, const bool is_rotated) const {
+	ERR_FAIL_NULL_V_MSG(get_database(), Vector2i(), "'database' is null.");
+	Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+	if (definition == nullptr)
+		return Vector2i();
+	return is_rotated ? definition->get_rotated_size() : definition->get_size();
+}
+
+PackedInt64Array GridInventory::_get_footprint_shape(const String &item_id, const bool is_rotated) const {
+	ERR_FAIL_NULL_V_MSG(get_database(), PackedInt64Array(), "'database' is null.");
+	Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+	if (definition == nullptr)
+		return PackedInt64Array();
+	return definition->get_shape_rows(is_rotated);
+}
+
+bool GridInventory::_placement_intersects(const StackPlacement &placement, const Rect2i &rect) const {
+	Rect2i placement_rect = Rect2i(placement.position, placement.size);
+	if (!placement_rect.intersects(rect))
+		return false;
+	if (placement.shape.is_empty())
+		return true;
+	Rect2i overlap = placement_rect.intersection(rect);
+	uint64_t columns = _get_row_mask(overlap.position.x - placement.position.x, overlap.size.x);
+	for (int y = overlap.position.y; y < overlap.position.y + overlap.size.y; y++) {
+		if ((uint64_t(placement.shape[y - placement.position.y]) & columns) != 0)
+			return true;
+	}
+	return false;
+}
+
+bool GridInventory::_footprints_overlap(const Rect2i &rect, const PackedInt64Array &shape, const Rect2i &other_rect, const PackedInt64Array &other_shape) {
+	if (!rect.intersects(other_rect))
+		return false;
+	if (shape.is_empty() && other_shape.is_empty())
+		return true;
+	Rect2i overlap = rect.intersection(other_rect);
+	uint64_t columns = _get_row_mask(0, overlap.size.x);
+	for (int y = overlap.position.y; y < overlap.position.y + overlap.size.y; y++) {
+		// Shaped footprints are at most 64 wide, so the shifts stay in the word.
+		uint64_t row = shape.is_empty() ? ~uint64_t(0) : uint64_t(shape[y - rect.position.y]) >> (overlap.position.x - rect.position.x);
+		uint64_t other_row = other_shape.is_empty() ? ~uint64_t(0) : uint64_t(other_shape[y - other_rect.position.y]) >> (overlap.position.x - other_rect.position.x);
+		if ((row & other_row & columns) != 0)
+			return true;
+	}
+	return false;
+}
+
+void GridInventory::_set_placement_position(const int stack_index, const Vector2i &position) {
+	stack_positions[stack_index] = position;
+	if (!placements_dirty && stack_index < (int)placements.size())
+		placements[stack_index].position = position;
+}
+
+void GridInventory::_set_placement_rotation(const int stack_index, const bool is_rotated) {
+	stack_rotations[stack_index] = is_rotated;
+	if (placements_dirty || stack_index >= (int)placements.size())
+		return;
+	StackPlacement &placement = placements[stack_index];
+	if (placement.rotated == is_rotated)
+		return;
+	placement.rotated = is_rotated;
+	placement.size = Vector2i(placement.size.y, placement.size.x);
+	if (placement.stack != nullptr)
+		placement.shape = _get_footprint_shape(placement.stack->get_item_id(), is_rotated);
+}
+
+void GridInventory::_set_placement_footprint(const int stack_index, const bool is_rotated) {
+	stack_rotations[stack_index] = is_rotated;
+	if (placements_dirty || stack_index >= (int)placements.size())
+		return;
+	StackPlacement &placement = placements[stack_index];
+	placement.rotated = is_rotated;
+	if (placement.stack != nullptr) {
+		placement.size = _get_footprint(placement.stack->get_item_id(), is_rotated);
+		placement.shape = _get_footprint_shape(placement.stack->get_item_id(), is_rotated);
+	}
+}
+
+void GridInventory::_grid_add(const Rect2i &rect, const Ref<ItemStack> &stack, const bool is_rotated) {
+	PackedInt64Array shape = _get_footprint_shape(stack->get_item_id(), is_rotated);
+	quad_tree->add(rect, stack);
+	_set_footprint_occupancy(rect, shape, true);
+	if (!free_rects_dirty) {
+		if (shape.is_empty()) {
+			_split_free_rects(rect);
+		} else {
+			// A shaped stack is carved run by run, its holes stay free.
+			for (int row = 0; row < shape.size(); row++) {
+				uint64_t bits = uint64_t(shape[row]);
+				while (bits != 0) {
+					int x = _count_trailing_zeros(bits);
+					int run = 0;
+					while (x + run < 64 && ((bits >> (x + run)) & 1) != 0) {
+						run++;
+					}
+					bits &= ~_get_row_mask(x, run);
+					_split_free_rects(Rect2i(rect.position.x + x, rect.position.y + row, run, 1));
+				}
+			}
+		}
+	}
+	grid_version++;
+}
+
+void GridInventory::_grid_remove(const Rect2i &rect, const Ref<ItemStack> &stack, const bool is_rotated) {
+	quad_tree->remove(stack);
+	_set_footprint_occupancy(rect, _get_footprint_shape(stack->get_item_id(), is_rotated), false);
+	// The bounding rect of a shaped stack also covers its holes, those were free already
+	// and the rects through them are found again, so the merge is the same.
+	if (!free_rects_dirty)
+		_merge_free_rects(rect);
+	grid_version++;
+}
+
+void GridInventory::_ensure_free_rects() const {
+	if (!free_rects_dirty)
+		return;
+	free_rects.clear();
+	free_rects.push_back(Rect2i(Vector2i(0, 0), size));
+	// Carve every run of occupied cells out, row by row.
+	// Runs crossing words are carved in parts, the result is the same.
+	for (int y = 0; y < size.y; y++) {
+		for (int word = 0; word < row_words; word++) {
+			uint64_t row = _get_occupancy_word(y, word);
+			while (row != 0) {
+				int x = _count_trailing_zeros(row);
+				int run = 0;
+				while (x + run < 64 && ((row >> (x + run)) & 1) != 0) {
+					run++;
+				}
+				row &= ~_get_row_mask(x, run);
+				_split_free_rects(Rect2i(word * 64 + x, y, run, 1));
+			}
+		}
+	}
+	free_rects_dirty = false;
+}
+
+void GridInventory::_split_free_rects(const Rect2i &used_rect) const {
+	Rect2i used = used_rect.intersection(Rect2i(Vector2i(0, 0), size));
+	if (used.size.x <= 0 || used.size.y <= 0)
+		return;
+	Vector2i used_end = used.get_end();
+
+	// Every free rect the used one overlaps is replaced by its parts left, right,
+	// above and below it. Those parts are maximal unless another rect encloses them.
+	LocalVector<Rect2i> split_rects;
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < free_rects.size(); i++) {
+		Rect2i free_rect = free_rects[i];
+		if (!free_rect.intersects(used)) {
+			free_rects[kept++] = free_rect;
+			continue;
+		}
+		Vector2i free_end = free_rect.get_end();
+		if (used.position.x > free_rect.position.x)
+			split_rects.push_back(Rect2i(free_rect.position.x, free_rect.position.y, used.position.x - free_rect.position.x, free_rect.size.y));
+		if (used_end.x < free_end.x)
+			split_rects.push_back(Rect2i(used_end.x, free_rect.position.y, free_end.x - used_end.x, free_rect.size.y));
+		if (used.position.y > free_rect.position.y)
+			split_rects.push_back(Rect2i(free_rect.position.x, free_rect.position.y, free_rect.size.x, used.position.y - free_rect.position.y));
+		if (used_end.y < free_end.y)
+			split_rects.push_back(Rect2i(free_rect.position.x, used_end.y, free_rect.size.x, free_end.y - used_end.y));
+	}
+	free_rects.resize(kept);
+
+	for (uint32_t i = 0; i < split_rects.size(); i++) {
+		const Rect2i &split_rect = split_rects[i];
+		bool enclosed = false;
+		for (uint32_t j = 0; j < kept && !enclosed; j++) {
+			enclosed = free_rects[j].encloses(split_rect);
+		}
+		// Equal parts are kept once, the first of them.
+		for (uint32_t j = 0; j < split_rects.size() && !enclosed; j++) {
+			if (j != i && split_rects[j].encloses(split_rect))
+				enclosed = split_rects[j] != split_rect || j < i;
+		}
+		if (!enclosed)
+			free_rects.push_back(split_rect);
+	}
+}
+
+bool GridInventory::_any_columns_set(const uint64_t *bits, const int x, const int width) {
+	int last_word = (x + width - 1) >> 6;
+	for (int word = x >> 6; word <= last_word; word++) {
+		if ((bits[word] & _get_word_mask(word, x, width)) != 0)
+			return true;
+	}
+	return false;
+}
+
+bool GridInventory::_all_columns_set(const uint64_t *bits, const int x, const int width) {
+	int last_word = (x + width - 1) >> 6;
+	for (int word = x >> 6; word <= last_word; word++) {
+		uint64_t mask = _get_word_mask(word, x, width);
+		if ((bits[word] & mask) != mask)
+			return false;
+	}
+	return true;
+}
+
+void GridInventory::_merge_free_rects(const Rect2i &freed_rect) const {
+	Rect2i freed = freed_rect.intersection(Rect2i(Vector2i(0, 0), size));
+	if (freed.size.x <= 0 || freed.size.y <= 0)
+		return;
+
+	LocalVector<uint64_t> free_rows;
+	_copy_occupancy(free_rows);
+	for (int y = 0; y < size.y; y++) {
+		for (int word = 0; word < row_words; word++) {
+			free_rows[y * row_words + word] = ~free_rows[y * row_words + word] & _get_word_mask(word, 0, size.x);
+		}
+	}
+
+	// Rects that gained cells all reach into the freed one. Each is a run of the columns
+	// free on every row from its top to its bottom that the rows around can't extend,
+	// so they are found by walking the row spans crossing the freed rows.
+	LocalVector<Rect2i> merged_rects;
+	LocalVector<uint64_t> head;
+	LocalVector<uint64_t> span;
+	head.resize(row_words);
+	span.resize(row_words);
+	for (int top = freed.position.y + freed.size.y - 1; top >= 0; top--) {
+		const uint64_t *top_row = &free_rows[top * row_words];
+		int first_bottom = MAX(top, freed.position.y);
+		// Above the freed rows, a span still has to reach down to the first of them.
+		for (int word = 0; word < row_words; word++) {
+			head[word] = top >= freed.position.y ? top_row[word] : head[word] & top_row[word];
+		}
+		if (!_any_columns_set(head.ptr(), freed.position.x, freed.size.x)) {
+			if (top < freed.position.y)
+				break;
+			continue;
+		}
+		const uint64_t *above = top > 0 ? &free_rows[(top - 1) * row_words] : nullptr;
+		for (int word = 0; word < row_words; word++) {
+			span[word] = head[word];
+		}
+		for (int bottom = first_bottom; bottom < size.y; bottom++) {
+			if (bottom > first_bottom) {
+				for (int word = 0; word < row_words; word++) {
+					span[word] &= free_rows[bottom * row_words + word];
+				}
+			}
+			if (!_any_columns_set(span.ptr(), freed.position.x, freed.size.x))
+				break;
+			const uint64_t *below = bottom + 1 < size.y ? &free_rows[(bottom + 1) * row_words] : nullptr;
+			_push_span_free_rects(span.ptr(), above, below, top, bottom, freed, merged_rects);
+		}
+	}
+
+	// The other rects stay maximal unless a merged one swallowed them.
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < free_rects.size(); i++) {
+		bool enclosed = false;
+		for (uint32_t j = 0; j < merged_rects.size() && !enclosed; j++) {
+			enclosed = merged_rects[j].encloses(free_rects[i]);
+		}
+		if (!enclosed)
+			free_rects[kept++] = free_rects[i];
+	}
+	free_rects.resize(kept);
+	for (uint32_t i = 0; i < merged_rects.size(); i++) {
+		free_rects.push_back(merged_rects[i]);
+	}
+}
+
+void GridInventory::_push_span_free_rects(const uint64_t *span, const uint64_t *above, const uint64_t *below, const int top, const int bottom, const Rect2i &freed, LocalVector<Rect2i> &r_rects) const {
+	// Runs of the span crossing the freed columns, kept when neither the row above
+	// nor the row below is free along the whole run.
+	int freed_end_x = freed.position.x + freed.size.x;
+	int x = freed.position.x;
+	while (x < freed_end_x) {
+		if (((span[x >> 6] >> (x & 63)) & 1) == 0) {
+			x++;
+			continue;
+		}
+		int run_begin = x;
+		while (run_begin > 0 && ((span[(run_begin - 1) >> 6] >> ((run_begin - 1) & 63)) & 1) != 0) {
+			run_begin--;
+		}
+		int run_end = x + 1;
+		while (run_end < size.x && ((span[run_end >> 6] >> (run_end & 63)) & 1) != 0) {
+			run_end++;
+		}
+		int width = run_end - run_begin;
+		bool extends_up = above != nullptr && _all_columns_set(above, run_begin, width);
+		bool extends_down = below != nullptr && _all_columns_set(below, run_begin, width);
+		if (!extends_up && !extends_down)
+			r_rects.push_back(Rect2i(run_begin, top, width, bottom - top + 1));
+		x = run_end;
+	}
+}
+
+bool GridInventory::_find_free_rect_place(const Vector2i &stack_size, Vector2i &r_position) const {
+	// The topmost, then leftmost place a stack fits is always the corner of a maximal free rect.
+	_ensure_free_rects();
+	bool found = false;
+	for (uint32_t i = 0; i < free_rects.size(); i++) {
+		const Rect2i &free_rect = free_rects[i];
+		if (free_rect.size.x < stack_size.x || free_rect.size.y < stack_size.y)
+			continue;
+		if (!found || free_rect.position.y < r_position.y || (free_rect.position.y == r_position.y && free_rect.position.x < r_position.x)) {
+			r_position = free_rect.position;
+			found = true;
+		}
+	}
+	return found;
 }
 
 void GridInventory::_bind_methods() {
@@ -30,6 +715,7 @@ void GridInventory::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_size"), &GridInventory::get_size);
 	ClassDB::bind_method(D_METHOD("set_grid_constraints", "grid_constraints"), &GridInventory::set_grid_constraints);
 	ClassDB::bind_method(D_METHOD("get_grid_constraints"), &GridInventory::get_grid_constraints);
+	ClassDB::bind_method(D_METHOD("refresh_constraint_masks"), &GridInventory::refresh_constraint_masks);
 	ClassDB::bind_method(D_METHOD("set_quad_tree", "quad_tree"), &GridInventory::set_quad_tree);
 	ClassDB::bind_method(D_METHOD("get_quad_tree"), &GridInventory::get_quad_tree);
 	ClassDB::bind_method(D_METHOD("set_stack_positions", "stack_positions"), &GridInventory::set_stack_positions);
@@ -55,9 +741,13 @@ void GridInventory::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("rect_free", "rect", "exception"), &GridInventory::rect_free, DEFVAL(nullptr));
 	// ClassDB::bind_method(D_METHOD("find_free_place", "stack_size", "exception"), &GridInventory::find_free_place, DEFVAL(nullptr));
 	ClassDB::bind_method(D_METHOD("has_free_place", "stack_size", "exception"), &GridInventory::has_free_place, DEFVAL(nullptr));
+	ClassDB::bind_method(D_METHOD("get_placement_map", "item_id", "is_rotated", "properties"), &GridInventory::get_placement_map, DEFVAL(false), DEFVAL(Dictionary()));
 	ClassDB::bind_method(D_METHOD("sort"), &GridInventory::sort);
+	ClassDB::bind_method(D_METHOD("plan_batch", "item_ids", "amounts", "properties", "time_budget_msec"), &GridInventory::plan_batch, DEFVAL(Array()), DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("add_batch", "item_ids", "amounts", "properties", "time_budget_msec"), &GridInventory::add_batch, DEFVAL(Array()), DEFVAL(0));
 
 	ADD_SIGNAL(MethodInfo("size_changed"));
+	ADD_SIGNAL(MethodInfo("stacks_swapped", PropertyInfo(Variant::INT, "stack_index"), PropertyInfo(Variant::OBJECT, "other_inventory"), PropertyInfo(Variant::INT, "other_stack_index")));
 
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR2I, "size"), "set_size", "get_size");
 	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "grid_constraints", PROPERTY_HINT_ARRAY_TYPE, vformat("%s/%s:%s", Variant::OBJECT, PROPERTY_HINT_RESOURCE_TYPE, "GridInventoryConstraint")), "set_grid_constraints", "get_grid_constraints");
@@ -80,15 +770,12 @@ void GridInventory::set_size(const Vector2i &new_size) {
 		return;
 	Vector2i old_size = size;
 	size = new_size;
-	if (size.x > 64 || size.y > 64) {
-		UtilityFunctions::printerr("GridInventory size is too large, it should not exceed 64x64.");
-		size = Vector2i(64, 64);
-	}
 	if (!Engine::get_singleton()->is_editor_hint()) {
 		if (_bounds_broken())
 			size = old_size;
 	}
 	if (size != old_size) {
+		placement_masks.clear();
 		_refresh_quad_tree();
 		emit_signal("size_changed");
 	}
@@ -100,12 +787,19 @@ Vector2i GridInventory::get_size() const {
 
 void GridInventory::set_grid_constraints(const TypedArray<GridInventoryConstraint> &new_grid_constraints) {
 	grid_constraints = new_grid_constraints;
+	placement_masks.clear();
+	grid_version++;
 }
 
 TypedArray<GridInventoryConstraint> GridInventory::get_grid_constraints() const {
 	return grid_constraints;
 }
 
+void GridInventory::refresh_constraint_masks() {
+	placement_masks.clear();
+	grid_version++;
+}
+
 void GridInventory::set_quad_tree(const Ref<QuadTree> &new_quad_tree) {
 	quad_tree = new_quad_tree;
 }
@@ -116,6 +810,7 @@ Ref<QuadTree> GridInventory::get_quad_tree() const {
 
 void GridInventory::set_stack_positions(const TypedArray<Vector2i> &new_stack_positions) {
 	stack_positions = new_stack_positions;
+	placements_dirty = true;
 }
 
 TypedArray<Vector2i> GridInventory::get_stack_positions() const {
@@ -124,6 +819,7 @@ TypedArray<Vector2i> GridInventory::get_stack_positions() const {
 
 void GridInventory::set_stack_rotations(const TypedArray<bool> &new_stack_rotations) {
 	stack_rotations = new_stack_rotations;
+	placements_dirty = true;
 }
 
 TypedArray<bool> GridInventory::get_stack_rotations() const {
@@ -133,23 +829,21 @@ TypedArray<bool> GridInventory::get_stack_rotations() const {
 Vector2i GridInventory::get_stack_position(const Ref<ItemStack> &stack) const {
 	ERR_FAIL_NULL_V_MSG(stack, Vector2i(0, 0), "stack' is null.");
 
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	if (stack_index == -1)
 		return Vector2i(0, 0);
 
 	ERR_FAIL_COND_V_MSG(stack_index >= stack_positions.size(), Vector2i(0, 0), "stack_index' is out of bounds for stack_positions.");
-	return stack_positions[stack_index];
+	return placements[stack_index].position;
 }
 
 bool GridInventory::set_stack_position(const Ref<ItemStack> &stack, const Vector2i new_position) {
-	Rect2i new_rect = Rect2i(new_position, get_stack_size(stack));
-	if (has_stack(stack) && !rect_free(new_rect, stack))
-		return false;
-
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	if (stack_index == -1)
 		return false;
-	stack_positions[stack_index] = new_position;
+	if (!_footprint_free(new_position, placements[stack_index].size, placements[stack_index].shape, stack))
+		return false;
+	_set_placement_position(stack_index, new_position);
 	return true;
 }
 
@@ -158,7 +852,10 @@ bool GridInventory::can_rotate_item(const Ref<ItemStack> &stack) const {
 	int temp = rotated_rect.size.x;
 	rotated_rect.size.x = rotated_rect.size.y;
 	rotated_rect.size.y = temp;
-	return rect_free(rotated_rect, stack);
+	if (stack == nullptr)
+		return rect_free(rotated_rect, stack);
+	PackedInt64Array rotated_shape = _get_footprint_shape(stack->get_item_id(), !is_stack_rotated(stack));
+	return _footprint_free(rotated_rect.position, rotated_rect.size, rotated_shape, stack);
 }
 
 void GridInventory::rotate(const Ref<ItemStack> &stack) {
@@ -173,54 +870,67 @@ void GridInventory::rotate(const Ref<ItemStack> &stack) {
 bool GridInventory::is_stack_rotated(const Ref<ItemStack> &stack) const {
 	ERR_FAIL_NULL_V_MSG(stack, false, "stack' is null.");
 
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	if (stack_index == -1)
 		return false;
 
 	ERR_FAIL_COND_V_MSG(stack_index >= stack_rotations.size(), false, "stack_index' is out of bounds for stack_rotations.");
-	return stack_rotations[stack_index];
+	return placements[stack_index].rotated;
 }
 
 Vector2i GridInventory::get_stack_size(const Ref<ItemStack> &stack) const {
-	bool is_rotated = is_stack_rotated(stack);
-	Ref<ItemDefinition> definition = get_database()->get_item(stack->get_item_id());
-	if (definition == nullptr)
-		return Vector2i();
-	Vector2i size = definition->get_size();
-	if (is_rotated) {
-		size = Vector2i(size.y, size.x);
-	}
-	return size;
+	ERR_FAIL_NULL_V_MSG(stack, Vector2i(), "stack' is null.");
+	int stack_index = _get_placement_index(stack);
+	if (stack_index == -1)
+		return _get_footprint(stack->get_item_id(), false);
+	return placements[stack_index].size;
 }
 
 Rect2i GridInventory::get_stack_rect(const Ref<ItemStack> &stack) const {
-	Vector2i item_pos = get_stack_position(stack);
-	Vector2i item_size = get_stack_size(stack);
-	return Rect2i(item_pos, item_size);
+	int stack_index = _get_placement_index(stack);
+	if (stack_index == -1 || stack_index >= stack_positions.size())
+		return Rect2i(Vector2i(0, 0), stack == nullptr ? Vector2i() : get_stack_size(stack));
+	const StackPlacement &placement = placements[stack_index];
+	return Rect2i(placement.position, placement.size);
 }
 
 Ref<ItemStack> GridInventory::get_stack_at(const Vector2i position) const {
-	Ref<QuadTree::QuadRect> first = quad_tree->get_first(position);
-	if (first == nullptr)
+	ERR_FAIL_NULL_V_MSG(quad_tree, nullptr, "'quad_tree' is null.");
+	int first = quad_tree->get_first_id(position);
+	if (first == -1)
 		return nullptr;
-	return first->get_metadata();
+	Ref<ItemStack> stack = quad_tree->get_payload_metadata(first);
+	Rect2i cell = Rect2i(position, Vector2i(1, 1));
+	int stack_index = _get_placement_index(stack);
+	if (stack_index == -1 || _placement_intersects(placements[stack_index], cell))
+		return stack;
+	// The rect of a shaped stack also spans its holes, another stack may lie there.
+	LocalVector<int> payloads;
+	quad_tree->get_all_ids(position, payloads);
+	for (uint32_t i = 0; i < payloads.size(); i++) {
+		Ref<ItemStack> other_stack = quad_tree->get_payload_metadata(payloads[i]);
+		int other_index = _get_placement_index(other_stack);
+		if (other_index != -1 && _placement_intersects(placements[other_index], cell))
+			return other_stack;
+	}
+	return nullptr;
 }
 
 int GridInventory::get_stack_index_at(const Vector2i position) const {
 	Ref<ItemStack> stack = get_stack_at(position);
 	if (stack == nullptr)
 		return -1;
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	return stack_index;
 }
 
 TypedArray<ItemStack> GridInventory::get_stacks_under(const Rect2i rect) const {
 	TypedArray<ItemStack> result = TypedArray<ItemStack>();
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		Rect2i stack_rect = get_stack_rect(stack);
-		if (stack_rect.intersects(rect))
-			result.append(stack);
+	_ensure_placements();
+	for (uint32_t i = 0; i < placements.size(); i++) {
+		const StackPlacement &placement = placements[i];
+		if (placement.stack != nullptr && _placement_intersects(placement, rect))
+			result.append(stacks[i]);
 	}
 	return result;
 }
@@ -235,17 +945,26 @@ int GridInventory::add_at_position(const Vector2i position, const String item_id
 		} else {
 			size = definition->get_size();
 		}
-		Rect2i rect = Rect2i(position, size);
-		if (rect_free(rect) && _can_add_on_position(position, item_id, amount, properties, is_rotated)) {
+		PackedInt64Array shape = definition->get_shape_rows(is_rotated);
+		if (_footprint_free(position, size, shape) && _can_add_on_position(position, item_id, amount, properties, is_rotated)) {
 			int no_added = add_on_new_stack(item_id, amount, properties, false);
 			if (no_added == amount)
 				return amount;
-			Ref<ItemStack> stack = stacks[stacks.size() - 1];
-			stack_rotations[stacks.size() - 1] = is_rotated;
-			bool move_success = move_stack_to(stack, position);
+			int new_stack_index = stacks.size() - 1;
+			Ref<ItemStack> stack = stacks[new_stack_index];
+			// Release the footprint it was inserted with before rotating it.
+			_grid_remove(get_stack_rect(stack), stack, is_stack_rotated(stack));
+			_set_placement_rotation(new_stack_index, is_rotated);
+			bool move_success = _footprint_free(position, get_stack_size(stack), shape, stack);
+			if (move_success) {
+				_set_placement_position(new_stack_index, position);
+				_flag_contents_changed = true;
+			}
+			_grid_add(get_stack_rect(stack), stack, is_rotated);
 			if (!move_success)
 				UtilityFunctions::printerr("Can't move the item to the given place!");
-			this->emit_signal("stack_added", stacks.size() - 1);
+			if (!is_batching())
+				this->emit_signal("stack_added", stacks.size() - 1);
 			return no_added;
 		}
 	} else {
@@ -260,8 +979,9 @@ int GridInventory::add_at_position(const Vector2i position, const String item_id
 
 bool GridInventory::move_stack_to(const Ref<ItemStack> stack, const Vector2i position) {
 	Vector2i stack_size = get_stack_size(stack);
-	Rect2i rect = Rect2i(position, stack_size);
-	if (rect_free(rect, stack)) {
+	int stack_index = _get_placement_index(stack);
+	PackedInt64Array shape = stack_index == -1 ? PackedInt64Array() : placements[stack_index].shape;
+	if (_footprint_free(position, stack_size, shape, stack)) {
 		_move_stack_to_unsafe(stack, position);
 		_flag_contents_changed = true;
 		return true;
@@ -288,7 +1008,7 @@ int GridInventory::transfer_to(const Vector2i from_position, GridInventory *dest
 		return amount;
 
 	int amount_of_stack = stack->get_amount();
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	ERR_FAIL_COND_V_MSG(stack_index < 0 || stack_index >= stacks.size(), amount, "The 'stack index' is out of bounds.");
 
 	String item_id = stack->get_item_id();
@@ -332,6 +1052,7 @@ int GridInventory::transfer_to(const Vector2i from_position, GridInventory *dest
 }
 
 bool GridInventory::swap_stacks(const Vector2i position, GridInventory *other_inventory, const Vector2i other_position) {
+	ERR_FAIL_NULL_V_MSG(other_inventory, false, "'other_inventory' is null.");
 	Ref<ItemStack> stack = get_stack_at(position);
 	if (stack == nullptr)
 		return false;
@@ -340,12 +1061,17 @@ bool GridInventory::swap_stacks(const Vector2i position, GridInventory *other_in
 		return false;
 	if (stack == other_stack)
 		return false;
-	Vector2i real_other_position = other_inventory->get_stack_position(other_stack);
-	if (!_size_check(stack, other_stack))
-		return false;
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	if (stack_index == -1)
 		return false;
+	int other_stack_index = other_inventory->_get_placement_index(other_stack);
+	if (other_stack_index == -1)
+		return false;
+	// Copies, both placements are rewritten below.
+	const StackPlacement placement = placements[stack_index];
+	const StackPlacement other_placement = other_inventory->placements[other_stack_index];
+	if (placement.size != other_placement.size)
+		return false;
 
 	String stack_item_id = stack->get_item_id();
 	String other_stack_item_id = other_stack->get_item_id();
@@ -356,12 +1082,10 @@ bool GridInventory::swap_stacks(const Vector2i position, GridInventory *other_in
 	int other_stack_amount = other_stack->get_amount();
 	Dictionary stack_properties = stack->get_properties();
 	Dictionary other_stack_properties = other_stack->get_properties();
-	bool stack_rotation = false;
-	bool other_stack_rotation = false;
-
-	int other_stack_index = other_inventory->stacks.find(other_stack);
-	if (other_stack_index == -1)
-		return false;
+	// Each stack takes the other's item in the other's orientation, so both
+	// footprints keep their size and only shaped stacks can change cells.
+	bool stack_rotation = other_placement.rotated;
+	bool other_stack_rotation = placement.rotated;
 
 	if (!_can_swap_to_inventory(this, other_stack_item_id, other_stack_amount, other_stack_properties))
 		return false;
@@ -369,21 +1093,57 @@ bool GridInventory::swap_stacks(const Vector2i position, GridInventory *other_in
 	if (!_can_swap_to_inventory(other_inventory, stack_item_id, stack_amount, stack_properties))
 		return false;
 
-	if (!_can_add_on_position(position, other_stack_item_id, other_stack_amount, other_stack_properties, other_stack_rotation))
-		return false;
+	// Each side gets an item it may not accept at all, unless both stacks stay in
+	// the same grid and only trade places.
+	if (other_inventory != this) {
+		if (!_can_add_on_inventory_from_constraints(other_stack_item_id, other_stack_amount, other_stack_properties))
+			return false;
+		if (!_can_add_new_stack_on_inventory_from_constraints(other_stack_item_id, other_stack_amount, other_stack_properties))
+			return false;
+		if (!other_inventory->_can_add_on_inventory_from_constraints(stack_item_id, stack_amount, stack_properties))
+			return false;
+		if (!other_inventory->_can_add_new_stack_on_inventory_from_constraints(stack_item_id, stack_amount, stack_properties))
+			return false;
+	}
 
-	if (!other_inventory->_can_add_on_position(real_other_position, stack_item_id, stack_amount, stack_properties, stack_rotation))
+	if (!_can_add_on_position(placement.position, other_stack_item_id, other_stack_amount, other_stack_properties, stack_rotation))
 		return false;
 
-	remove_at(stack_index, stack_item_id, stack_amount);
+	if (!other_inventory->_can_add_on_position(other_placement.position, stack_item_id, stack_amount, stack_properties, other_stack_rotation))
+		return false;
 
-	other_stack_index = other_inventory->stacks.find(other_stack);
+	Rect2i rect = Rect2i(placement.position, placement.size);
+	Rect2i other_rect = Rect2i(other_placement.position, other_placement.size);
+	PackedInt64Array shape = _get_footprint_shape(other_stack_item_id, stack_rotation);
+	PackedInt64Array other_shape = other_inventory->_get_footprint_shape(stack_item_id, other_stack_rotation);
+	bool is_shaped = !shape.is_empty() || !other_shape.is_empty() || !placement.shape.is_empty() || !other_placement.shape.is_empty();
+	if (is_shaped) {
+		// Within one grid the cells of the other stack count as taken, which may
+		// refuse a few swaps where the shapes would interlock.
+		if (!_footprint_free(rect.position, rect.size, shape, stack))
+			return false;
+		if (!other_inventory->_footprint_free(other_rect.position, other_rect.size, other_shape, other_stack))
+			return false;
+		if (other_inventory == this && _footprints_overlap(rect, shape, other_rect, other_shape))
+			return false;
+		_grid_remove(rect, stack, placement.rotated);
+		other_inventory->_grid_remove(other_rect, other_stack, other_placement.rotated);
+	}
 
-	other_inventory->remove_at(other_stack_index, other_stack_item_id, other_stack_amount);
+	_replace_stack_content(stack_index, other_stack_item_id, other_stack_amount, other_stack_properties);
+	other_inventory->_replace_stack_content(other_stack_index, stack_item_id, stack_amount, stack_properties);
+	_set_placement_footprint(stack_index, stack_rotation);
+	other_inventory->_set_placement_footprint(other_stack_index, other_stack_rotation);
 
-	add_at_position(position, other_stack_item_id, other_stack_amount, other_stack_properties);
-	other_inventory->add_at_position(real_other_position, stack_item_id, stack_amount, stack_properties);
+	if (is_shaped) {
+		_grid_add(rect, stack, stack_rotation);
+		other_inventory->_grid_add(other_rect, other_stack, other_stack_rotation);
+	}
 
+	if (!is_batching())
+		emit_signal("stacks_swapped", stack_index, other_inventory, other_stack_index);
+	if (other_inventory != this && !other_inventory->is_batching())
+		other_inventory->emit_signal("stacks_swapped", other_stack_index, this, stack_index);
 	return true;
 }
 
@@ -395,8 +1155,27 @@ bool GridInventory::rect_free(const Rect2i &rect, const Ref<ItemStack> &exceptio
 	if (rect.position.y + rect.size.y > size.y)
 		return false;
 
-	ERR_FAIL_NULL_V_MSG(quad_tree, 0, "'quad_tree' is null.");
-	return quad_tree->get_first(rect, exception) == nullptr;
+	StackException stack_exception = _get_exception(exception);
+	bool is_free = true;
+	int last_word = (rect.position.x + rect.size.x - 1) >> 6;
+	for (int word = rect.position.x >> 6; word <= last_word && is_free; word++) {
+		uint64_t blocked = _get_blocked_columns(rect.position.y, rect.size.y, word, stack_exception);
+		is_free = (blocked & _get_word_mask(word, rect.position.x, rect.size.x)) == 0;
+	}
+#ifdef DEV_ENABLED
+	ERR_FAIL_NULL_V_MSG(quad_tree, false, "'quad_tree' is null.");
+	int exception_key = exception == nullptr ? -1 : quad_tree->find_key(exception);
+	LocalVector<int> payloads;
+	quad_tree->get_all_ids(rect, payloads, exception_key);
+	bool tree_free = true;
+	for (uint32_t i = 0; i < payloads.size() && tree_free; i++) {
+		int stack_index = _get_placement_index(quad_tree->get_payload_metadata(payloads[i]));
+		tree_free = stack_index != -1 && !_placement_intersects(placements[stack_index], rect);
+	}
+	if (is_free != tree_free)
+		ERR_PRINT(vformat("GridInventory occupancy disagrees with the quad tree at %s.", rect));
+#endif
+	return is_free;
 }
 
 Vector2i GridInventory::find_free_place(const Vector2i item_size, const String item_id, const int amount, const Dictionary properties, const bool is_rotated, const Ref<ItemStack> &exception) const {
@@ -411,81 +1190,628 @@ Vector2i GridInventory::find_free_place(const Vector2i item_size, const String i
 		return result;
 	}
 
-	for (size_t y = 0; y < (size.y - (final_size.y - 1)); y++) {
-		for (size_t x = 0; x < (size.x - (final_size.x - 1)); x++) {
-			Rect2i rect = Rect2i(Vector2i(x, y), final_size);
-			if (rect_free(rect, exception) && _can_add_on_position(Vector2i(x, y), item_id, amount, properties, is_rotated)) {
-				return Vector2i(x, y);
-			}
+	if (final_size.x < 1 || final_size.y < 1) {
+		return result;
+	}
+
+	StackException stack_exception = _get_exception(exception);
+	PackedInt64Array shape = _get_footprint_shape(item_id, is_rotated);
+	const PlacementMask *mask = grid_constraints.is_empty() ? nullptr : _get_placement_mask(item_id, is_rotated);
+	// Answers only depend on the grid when no constraint has to be asked per cell,
+	// so the search done by can_add_new_stack is reused by on_insert_stack.
+	int item_handle = exception == nullptr ? _get_item_handle(item_id) : -1;
+	// Wide grids have no mask, there every constraint is asked per cell.
+	bool can_memoize = item_handle != -1 && (grid_constraints.is_empty() || (mask != nullptr && mask->dynamic_constraints.is_empty()));
+	if (can_memoize && free_place_memo.grid_version == grid_version && free_place_memo.item_handle == item_handle && free_place_memo.is_rotated == is_rotated && free_place_memo.stack_size == final_size)
+		return free_place_memo.position;
+
+	// Free rects only answer for rectangles, a shaped stack may fit where its rect doesn't.
+	Vector2i free_rect_place;
+	if (exception != nullptr || !shape.is_empty()) {
+		result = _scan_free_place(final_size, shape, mask, stack_exception, item_id, amount, properties, is_rotated);
+	} else if (_find_free_rect_place(final_size, free_rect_place)) {
+		if (grid_constraints.is_empty()) {
+			result = free_rect_place;
+#ifdef DEV_ENABLED
+			if (result != _scan_free_place(final_size, shape, mask, stack_exception, item_id, amount, properties, is_rotated))
+				ERR_PRINT(vformat("GridInventory free rects disagree with the occupancy for %s.", final_size));
+#endif
+		} else {
+			result = _scan_free_place(final_size, shape, mask, stack_exception, item_id, amount, properties, is_rotated);
 		}
 	}
+
+	if (can_memoize) {
+		free_place_memo.item_handle = item_handle;
+		free_place_memo.is_rotated = is_rotated;
+		free_place_memo.stack_size = final_size;
+		free_place_memo.grid_version = grid_version;
+		free_place_memo.position = result;
+	}
 	return result;
 }
 
+Vector2i GridInventory::_scan_free_place(const Vector2i &final_size, const PackedInt64Array &shape, const PlacementMask *mask, const StackException &exception, const String &item_id, const int amount, const Dictionary &properties, const bool is_rotated, uint8_t *r_map) const {
+	// With a map every valid start is marked and the first one is returned at the end.
+	Vector2i first = Vector2i(-1, -1);
+	if (!shape.is_empty()) {
+		// Every shape row shifted against the occupancy row under it, for all starts of a word at once.
+		for (int y = 0; y < (size.y - (final_size.y - 1)); y++) {
+			for (int word = 0; word < row_words; word++) {
+				uint64_t candidates = _get_start_columns(word, final_size.x);
+				if (mask != nullptr)
+					candidates &= mask->rows[y];
+				for (int row = 0; row < final_size.y && candidates != 0; row++) {
+					uint64_t shape_row = uint64_t(shape[row]);
+					if (shape_row == 0)
+						continue;
+					uint64_t free_columns = ~_get_blocked_columns(y + row, 1, word, exception);
+					uint64_t next_free_columns = word + 1 < row_words ? ~_get_blocked_columns(y + row, 1, word + 1, exception) : 0;
+					candidates = _get_shape_start_candidates(free_columns, next_free_columns, candidates, shape_row);
+				}
+				while (candidates != 0) {
+					int x = word * 64 + _count_trailing_zeros(candidates);
+					candidates &= candidates - 1;
+					bool can_add = mask != nullptr ? _passes_dynamic_constraints(mask, Vector2i(x, y), item_id, amount, properties, is_rotated) : _can_add_on_position(Vector2i(x, y), item_id, amount, properties, is_rotated);
+					if (!can_add)
+						continue;
+					if (r_map == nullptr)
+						return Vector2i(x, y);
+					r_map[y * size.x + x] = 1;
+					if (first.x == -1)
+						first = Vector2i(x, y);
+				}
+			}
+		}
+		return first;
+	}
+	// Stacks wider than a word span more than two words, they test the whole row band.
+	bool is_wide = final_size.x > 64;
+	LocalVector<uint64_t> free_words;
+	for (int y = 0; y < (size.y - (final_size.y - 1)); y++) {
+		if (is_wide)
+			_get_free_words(y, final_size.y, exception, free_words);
+		uint64_t free_columns = 0;
+		bool has_free_columns = false;
+		for (int word = 0; word < row_words; word++) {
+			// A stack starting in a full tile would cover a used cell.
+			if (_is_tile_full(y, word)) {
+				has_free_columns = false;
+				continue;
+			}
+			uint64_t candidates = _get_start_columns(word, final_size.x);
+			if (is_wide) {
+				candidates &= _get_span_start_candidates(free_words.ptr(), row_words, word, final_size.x);
+			} else {
+				if (!has_free_columns)
+					free_columns = ~_get_blocked_columns(y, final_size.y, word, exception);
+				uint64_t next_free_columns = word + 1 < row_words ? ~_get_blocked_columns(y, final_size.y, word + 1, exception) : 0;
+				candidates = _get_start_candidates(free_columns, next_free_columns, candidates, final_size.x);
+				free_columns = next_free_columns;
+				has_free_columns = true;
+			}
+			// Masks only exist for grids up to 64 columns wide.
+			if (mask != nullptr)
+				candidates &= mask->rows[y];
+			while (candidates != 0) {
+				int x = word * 64 + _count_trailing_zeros(candidates);
+				candidates &= candidates - 1;
+				bool can_add = mask != nullptr ? _passes_dynamic_constraints(mask, Vector2i(x, y), item_id, amount, properties, is_rotated) : _can_add_on_position(Vector2i(x, y), item_id, amount, properties, is_rotated);
+				if (!can_add)
+					continue;
+				if (r_map == nullptr)
+					return Vector2i(x, y);
+				r_map[y * size.x + x] = 1;
+				if (first.x == -1)
+					first = Vector2i(x, y);
+			}
+		}
+	}
+	return first;
+}
+
 bool GridInventory::has_free_place(const Vector2i stack_size, const Ref<ItemStack> &exception) const {
-	for (size_t y = 0; y < (size.y - (stack_size.y - 1)); y++) {
-		for (size_t x = 0; x < (size.x - (stack_size.x - 1)); x++) {
-			Rect2i rect = Rect2i(Vector2i(x, y), stack_size);
-			if (rect_free(rect, exception)) {
+	if (stack_size.x < 1 || stack_size.y < 1 || stack_size.x > size.x || stack_size.y > size.y)
+		return false;
+	if (exception == nullptr) {
+		Vector2i position;
+		return _find_free_rect_place(stack_size, position);
+	}
+	StackException stack_exception = _get_exception(exception);
+	LocalVector<uint64_t> free_words;
+	for (int y = 0; y < (size.y - (stack_size.y - 1)); y++) {
+		_get_free_words(y, stack_size.y, stack_exception, free_words);
+		for (int word = 0; word < row_words; word++) {
+			if ((_get_start_columns(word, stack_size.x) & _get_span_start_candidates(free_words.ptr(), row_words, word, stack_size.x)) != 0)
 				return true;
-			}
 		}
 	}
 	return false;
 }
 
+PackedByteArray GridInventory::get_placement_map(const String &item_id, const bool is_rotated, const Dictionary &properties) const {
+	PackedByteArray map;
+	ERR_FAIL_NULL_V_MSG(get_database(), map, "'database' is null.");
+	Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+	ERR_FAIL_NULL_V_MSG(definition, map, "'definition' is null.");
+	map.resize(size.x * size.y);
+	map.fill(0);
+
+	Vector2i final_size = _get_footprint(item_id, is_rotated);
+	if (final_size.x < 1 || final_size.y < 1 || final_size.x > size.x || final_size.y > size.y)
+		return map;
+	// Inventory constraints don't depend on the cell, one refusal empties the whole map.
+	if (!Inventory::can_add_new_stack(item_id, 1, properties))
+		return map;
+
+	const PlacementMask *mask = grid_constraints.is_empty() ? nullptr : _get_placement_mask(item_id, is_rotated);
+	_scan_free_place(final_size, _get_footprint_shape(item_id, is_rotated), mask, StackException(), item_id, 1, properties, is_rotated, map.ptrw());
+	return map;
+}
+
+Vector2i GridInventory::_find_pack_place(const LocalVector<uint64_t> &rows, const Vector2i stack_size, const PackEntry &entry, const bool is_rotated, const int max_y) const {
+	if (stack_size.x > size.x || stack_size.y > size.y)
+		return Vector2i(-1, -1);
+	const PlacementMask *mask = grid_constraints.is_empty() ? nullptr : _get_placement_mask(entry.item_id, is_rotated);
+	const PackedInt64Array &shape = is_rotated ? entry.rotated_shape : entry.shape;
+	LocalVector<uint64_t> free_words;
+	int last_y = MIN(size.y - stack_size.y, max_y);
+	for (int y = 0; y <= last_y; y++) {
+		if (!shape.is_empty()) {
+			for (int word = 0; word < row_words; word++) {
+				uint64_t candidates = _get_start_columns(word, stack_size.x);
+				if (mask != nullptr)
+					candidates &= mask->rows[y];
+				for (int row = 0; row < stack_size.y && candidates != 0; row++) {
+					uint64_t shape_row = uint64_t(shape[row]);
+					if (shape_row == 0)
+						continue;
+					int row_index = (y + row) * row_words + word;
+					uint64_t next_free_columns = word + 1 < row_words ? ~rows[row_index + 1] : 0;
+					candidates = _get_shape_start_candidates(~rows[row_index], next_free_columns, candidates, shape_row);
+				}
+				while (candidates != 0) {
+					int x = word * 64 + _count_trailing_zeros(candidates);
+					candidates &= candidates - 1;
+					if (grid_constraints.is_empty())
+						return Vector2i(x, y);
+					bool can_add = mask != nullptr ? _passes_dynamic_constraints(mask, Vector2i(x, y), entry.item_id, entry.amount, entry.properties, is_rotated) : _can_add_on_position(Vector2i(x, y), entry.item_id, entry.amount, entry.properties, is_rotated);
+					if (can_add)
+						return Vector2i(x, y);
+				}
+			}
+			continue;
+		}
+		if (stack_size.x > 64) {
+			// Spans more than two words, the free columns of the whole row band are needed.
+			free_words.resize(row_words);
+			for (int word = 0; word < row_words; word++) {
+				uint64_t blocked = 0;
+				for (int row = y; row < y + stack_size.y; row++) {
+					blocked |= rows[row * row_words + word];
+				}
+				free_words[word] = ~blocked;
+			}
+		}
+		uint64_t next_blocked = 0;
+		for (int row = y; row < y + stack_size.y; row++) {
+			next_blocked |= rows[row * row_words];
+		}
+		for (int word = 0; word < row_words; word++) {
+			uint64_t free_columns = ~next_blocked;
+			next_blocked = 0;
+			if (word + 1 < row_words) {
+				for (int row = y; row < y + stack_size.y; row++) {
+					next_blocked |= rows[row * row_words + word + 1];
+				}
+			}
+			uint64_t next_free_columns = word + 1 < row_words ? ~next_blocked : 0;
+			uint64_t candidates = _get_start_columns(word, stack_size.x);
+			if (stack_size.x > 64) {
+				candidates &= _get_span_start_candidates(free_words.ptr(), row_words, word, stack_size.x);
+			} else {
+				candidates = _get_start_candidates(free_columns, next_free_columns, candidates, stack_size.x);
+			}
+			if (mask != nullptr)
+				candidates &= mask->rows[y];
+			while (candidates != 0) {
+				int x = word * 64 + _count_trailing_zeros(candidates);
+				candidates &= candidates - 1;
+				if (grid_constraints.is_empty())
+					return Vector2i(x, y);
+				bool can_add = mask != nullptr ? _passes_dynamic_constraints(mask, Vector2i(x, y), entry.item_id, entry.amount, entry.properties, is_rotated) : _can_add_on_position(Vector2i(x, y), entry.item_id, entry.amount, entry.properties, is_rotated);
+				if (can_add)
+					return Vector2i(x, y);
+			}
+		}
+	}
+	return Vector2i(-1, -1);
+}
+
+int GridInventory::_pack_entries(const LocalVector<PackEntry> &entries, const LocalVector<uint64_t> &initial_rows, LocalVector<Vector2i> &r_positions, LocalVector<bool> &r_rotations) const {
+	// Bottom-left fill on a scratch bitboard laid out like the occupancy: each stack
+	// goes to the topmost, then leftmost cell where either of its orientations fits.
+	// Stacks that fit nowhere get (-1, -1), the area placed is returned.
+	LocalVector<uint64_t> rows = initial_rows;
+	int placed_area = 0;
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		const PackEntry &entry = entries[i];
+		Vector2i best_position = Vector2i(-1, -1);
+		bool best_rotated = false;
+		Vector2i best_size;
+		for (int rotation = 0; rotation < 2; rotation++) {
+			bool is_rotated = rotation == 1;
+			if (is_rotated && entry.size.x == entry.size.y)
+				break;
+			Vector2i stack_size = is_rotated ? Vector2i(entry.size.y, entry.size.x) : entry.size;
+			int max_y = best_position.y == -1 ? size.y : best_position.y;
+			Vector2i position = _find_pack_place(rows, stack_size, entry, is_rotated, max_y);
+			if (position == Vector2i(-1, -1))
+				continue;
+			if (best_position.y == -1 || position.y < best_position.y || (position.y == best_position.y && position.x < best_position.x)) {
+				best_position = position;
+				best_rotated = is_rotated;
+				best_size = stack_size;
+			}
+		}
+		r_positions[entry.index] = best_position;
+		r_rotations[entry.index] = best_rotated;
+		if (best_position == Vector2i(-1, -1))
+			continue;
+		const PackedInt64Array &shape = best_rotated ? entry.rotated_shape : entry.shape;
+		int last_word = (best_position.x + best_size.x - 1) >> 6;
+		for (int word = best_position.x >> 6; word <= last_word; word++) {
+			uint64_t mask = _get_word_mask(word, best_position.x, best_size.x);
+			for (int y = best_position.y; y < best_position.y + best_size.y; y++) {
+				if (!shape.is_empty())
+					mask = _get_shifted_word(uint64_t(shape[y - best_position.y]), best_position.x, word);
+				rows[y * row_words + word] |= mask;
+			}
+		}
+		placed_area += entry.area;
+	}
+	return placed_area;
+}
+
 bool GridInventory::sort() {
-	// TypedArray<ItemStack> stack_array;
-	// for (size_t i = 0; i < stacks.size(); i++) {
-	// 	Ref<ItemStack> stack = stacks[i];
-	// 	stack_array.append(stack);
-	// 	stack_array.sort_custom(callable_mp(this, &GridInventory::_compare_stacks));
-	// }
+	_ensure_placements();
+	LocalVector<PackEntry> entries;
+	entries.reserve(stacks.size());
+	LocalVector<Vector2i> new_positions;
+	LocalVector<bool> new_rotations;
+	new_positions.resize(stacks.size());
+	new_rotations.resize(stacks.size());
+	int total_area = 0;
+	for (int i = 0; i < stacks.size(); i++) {
+		new_positions[i] = placements[i].position;
+		new_rotations[i] = placements[i].rotated;
+		if (placements[i].stack == nullptr)
+			continue;
+		PackEntry entry;
+		entry.index = i;
+		entry.size = placements[i].rotated ? Vector2i(placements[i].size.y, placements[i].size.x) : placements[i].size;
+		ERR_FAIL_COND_V_MSG(entry.size.x < 1 || entry.size.y < 1, false, "Can't sort a stack without a valid item definition.");
+		entry.area = entry.size.x * entry.size.y;
+		entry.longest_side = MAX(entry.size.x, entry.size.y);
+		entry.item_id = placements[i].stack->get_item_id();
+		entry.amount = placements[i].stack->get_amount();
+		entry.properties = placements[i].stack->get_properties();
+		entry.shape = _get_footprint_shape(entry.item_id, false);
+		entry.rotated_shape = _get_footprint_shape(entry.item_id, true);
+		total_area += entry.area;
+		entries.push_back(entry);
+	}
 
-	// for (size_t i = 0; i < stack_array.size(); i++) {
-	// 	Ref<ItemStack> stack = stack_array[i];
-	// 	_move_stack_to_unsafe(stack, -get_stack_size(stack));
-	// }
+	// Largest first packs tightest in most mixes, long thin items are the usual
+	// reason it fails so they get a second chance going first.
+	LocalVector<uint64_t> empty_rows;
+	empty_rows.resize(size.y * row_words);
+	for (uint32_t i = 0; i < empty_rows.size(); i++) {
+		empty_rows[i] = 0;
+	}
+	entries.sort_custom<PackEntryByArea>();
+	bool packed = _pack_entries(entries, empty_rows, new_positions, new_rotations) == total_area;
+	if (!packed) {
+		entries.sort_custom<PackEntryBySide>();
+		packed = _pack_entries(entries, empty_rows, new_positions, new_rotations) == total_area;
+	}
+	if (!packed)
+		return false;
 
-	// for (size_t i = 0; i < stack_array.size(); i++) {
-	// 	Ref<ItemStack> stack = stack_array[i];
-	// 	Vector2i free_place = find_free_place(get_stack_size(stack), stack->get_item_id(), stack->get_amount(), stack->get_properties());
-	// 	if (free_place == Vector2i(-1, -1))
-	// 		return false;
-	// 	move_stack_to(stack, free_place);
-	// }
+	begin_batch();
+	// Lift every stack before placing any, the new rects may overlap old ones.
+	for (int i = 0; i < stacks.size(); i++) {
+		Ref<ItemStack> stack = stacks[i];
+		if (stack != nullptr)
+			_grid_remove(get_stack_rect(stack), stack, placements[i].rotated);
+	}
+	for (int i = 0; i < stacks.size(); i++) {
+		Ref<ItemStack> stack = stacks[i];
+		if (stack == nullptr)
+			continue;
+		if (placements[i].position != new_positions[i] || placements[i].rotated != new_rotations[i]) {
+			_set_placement_rotation(i, new_rotations[i]);
+			_set_placement_position(i, new_positions[i]);
+			_record_batch_change(stack, stack->get_item_id(), stack->get_amount(), stack->get_item_id(), stack->get_amount());
+		}
+		_grid_add(get_stack_rect(stack), stack, new_rotations[i]);
+	}
+	commit_batch();
 	return true;
 }
 
+void GridInventory::_plan_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties, const float time_budget_msec, BatchPlan &r_plan) const {
+	r_plan.leftovers = amounts;
+	r_plan.merges.clear();
+	r_plan.new_stacks.clear();
+	ERR_FAIL_COND_MSG(item_ids.size() != amounts.size(), "The 'item_ids' and 'amounts' sizes differ.");
+	ERR_FAIL_COND_MSG(!properties.is_empty() && properties.size() != item_ids.size(), "The 'properties' must be empty or the same size as 'item_ids'.");
+	ERR_FAIL_NULL_MSG(get_database(), "'database' is null.");
+	uint64_t deadline = 0;
+	if (time_budget_msec > 0)
+		deadline = Time::get_singleton()->get_ticks_usec() + (uint64_t)(time_budget_msec * 1000.0f);
+
+	// Existing stacks of the requested items, walked once.
+	const int count = item_ids.size();
+	HashMap<String, LocalVector<int>> stacks_by_item;
+	for (int i = 0; i < count; i++) {
+		if (amounts[i] > 0 && !stacks_by_item.has(item_ids[i]))
+			stacks_by_item.insert(item_ids[i], LocalVector<int>());
+	}
+	for (int stack_index = 0; stack_index < stacks.size(); stack_index++) {
+		Ref<ItemStack> stack = stacks[stack_index];
+		if (stack == nullptr || !stack->has_valid())
+			continue;
+		LocalVector<int> *item_stacks = stacks_by_item.getptr(stack->get_item_id());
+		if (item_stacks != nullptr)
+			item_stacks->push_back(stack_index);
+	}
+
+	// Top up existing stacks first, what is left is split in new stacks of at most max stack.
+	// New stacks that could never fit in the free cells left are not planned.
+	int free_cells = _get_free_cells();
+	LocalVector<int> used_room;
+	used_room.resize(stacks.size());
+	for (uint32_t i = 0; i < used_room.size(); i++) {
+		used_room[i] = 0;
+	}
+	LocalVector<PackEntry> entries;
+	int total_area = 0;
+	for (int i = 0; i < count; i++) {
+		ERR_CONTINUE_MSG(amounts[i] < 0, "The 'amount' is negative.");
+		int remaining = amounts[i];
+		if (remaining == 0)
+			continue;
+		const String item_id = item_ids[i];
+		Dictionary item_properties;
+		if (!properties.is_empty())
+			item_properties = properties[i];
+		if (!_can_add_on_inventory_from_constraints(item_id, remaining, item_properties))
+			continue;
+		int item_handle = _get_item_handle(item_id);
+		int max_stack = _get_max_stack_for_stack(item_handle, item_id, remaining, item_properties);
+		const LocalVector<int> &item_stacks = stacks_by_item[item_id];
+		for (uint32_t s = 0; s < item_stacks.size() && remaining > 0; s++) {
+			int stack_index = item_stacks[s];
+			Ref<ItemStack> stack = stacks[stack_index];
+			if (stack->get_properties() != item_properties)
+				continue;
+			int amount_to_add = _get_amount_to_add_from_constraints(item_id, remaining, item_properties);
+			amount_to_add = MIN(amount_to_add, max_stack - stack->get_amount() - used_room[stack_index]);
+			if (amount_to_add <= 0)
+				continue;
+			BatchMerge merge;
+			merge.request = i;
+			merge.stack_index = stack_index;
+			merge.amount = amount_to_add;
+			r_plan.merges.push_back(merge);
+			used_room[stack_index] += amount_to_add;
+			remaining -= amount_to_add;
+		}
+
+		Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+		if (definition == nullptr || max_stack <= 0) {
+			r_plan.leftovers.set(i, remaining);
+			continue;
+		}
+		Vector2i item_size = definition->get_size();
+		PackedInt64Array shape = definition->get_shape_rows(false);
+		// Shaped items are counted by the cells they take.
+		int area = item_size.x * item_size.y;
+		if (!shape.is_empty()) {
+			area = 0;
+			for (int row = 0; row < shape.size(); row++) {
+				area += _count_set_bits(uint64_t(shape[row]));
+			}
+		}
+		while (remaining > 0 && area > 0 && area <= free_cells) {
+			int amount_to_add = _get_amount_to_add_from_constraints(item_id, MIN(remaining, max_stack), item_properties);
+			if (amount_to_add <= 0 || !Inventory::can_add_new_stack(item_id, amount_to_add, item_properties))
+				break;
+			PackEntry entry;
+			entry.index = r_plan.new_stacks.size();
+			entry.size = item_size;
+			entry.area = area;
+			entry.longest_side = MAX(item_size.x, item_size.y);
+			entry.item_id = item_id;
+			entry.amount = amount_to_add;
+			entry.properties = item_properties;
+			entry.shape = shape;
+			entry.rotated_shape = definition->get_shape_rows(true);
+			entries.push_back(entry);
+			BatchStack new_stack;
+			new_stack.request = i;
+			new_stack.amount = amount_to_add;
+			r_plan.new_stacks.push_back(new_stack);
+			total_area += area;
+			free_cells -= area;
+			remaining -= amount_to_add;
+		}
+		r_plan.leftovers.set(i, remaining);
+	}
+	if (entries.is_empty())
+		return;
+
+	// Largest first on the current occupancy. With a time budget, when something is
+	// left out, longest side first and then the largest first order with one pair of
+	// neighbours swapped are tried until all fit or the budget runs out.
+	LocalVector<Vector2i> best_positions;
+	LocalVector<bool> best_rotations;
+	best_positions.resize(entries.size());
+	best_rotations.resize(entries.size());
+	LocalVector<uint64_t> rows;
+	_copy_occupancy(rows);
+	entries.sort_custom<PackEntryByArea>();
+	int best_area = _pack_entries(entries, rows, best_positions, best_rotations);
+	if (best_area < total_area && deadline != 0) {
+		LocalVector<Vector2i> positions;
+		LocalVector<bool> rotations;
+		positions.resize(entries.size());
+		rotations.resize(entries.size());
+		LocalVector<PackEntry> by_side = entries;
+		by_side.sort_custom<PackEntryBySide>();
+		int area = _pack_entries(by_side, rows, positions, rotations);
+		if (area > best_area) {
+			best_area = area;
+			best_positions = positions;
+			best_rotations = rotations;
+		}
+		for (uint32_t k = 0; k + 1 < entries.size() && best_area < total_area && Time::get_singleton()->get_ticks_usec() < deadline; k++) {
+			if (entries[k].size == entries[k + 1].size)
+				continue;
+			SWAP(entries[k], entries[k + 1]);
+			area = _pack_entries(entries, rows, positions, rotations);
+			SWAP(entries[k], entries[k + 1]);
+			if (area > best_area) {
+				best_area = area;
+				best_positions = positions;
+				best_rotations = rotations;
+			}
+		}
+	}
+
+	LocalVector<BatchStack> placed_stacks;
+	placed_stacks.reserve(r_plan.new_stacks.size());
+	for (uint32_t i = 0; i < r_plan.new_stacks.size(); i++) {
+		BatchStack &new_stack = r_plan.new_stacks[i];
+		if (best_positions[i] == Vector2i(-1, -1)) {
+			r_plan.leftovers.set(new_stack.request, r_plan.leftovers[new_stack.request] + new_stack.amount);
+			continue;
+		}
+		new_stack.position = best_positions[i];
+		new_stack.is_rotated = best_rotations[i];
+		placed_stacks.push_back(new_stack);
+	}
+	r_plan.new_stacks = placed_stacks;
+}
+
+PackedInt32Array GridInventory::plan_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties, const float time_budget_msec) const {
+	BatchPlan plan;
+	_plan_batch(item_ids, amounts, properties, time_budget_msec, plan);
+	return plan.leftovers;
+}
+
+PackedInt32Array GridInventory::add_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties, const float time_budget_msec) {
+	BatchPlan plan;
+	_plan_batch(item_ids, amounts, properties, time_budget_msec, plan);
+	PackedInt32Array leftovers = plan.leftovers;
+	if (plan.merges.is_empty() && plan.new_stacks.is_empty())
+		return leftovers;
+
+	// Merges first, new stacks only append so the planned stack indices stay valid.
+	begin_batch();
+	for (uint32_t i = 0; i < plan.merges.size(); i++) {
+		const BatchMerge &merge = plan.merges[i];
+		const String item_id = item_ids[merge.request];
+		Dictionary item_properties;
+		if (!properties.is_empty())
+			item_properties = properties[merge.request];
+		int not_added = _add_to_stack(merge.stack_index, item_id, _get_item_handle(item_id), merge.amount, item_properties, false);
+		leftovers.set(merge.request, leftovers[merge.request] + not_added);
+	}
+	for (uint32_t i = 0; i < plan.new_stacks.size(); i++) {
+		const BatchStack &new_stack = plan.new_stacks[i];
+		Dictionary item_properties;
+		if (!properties.is_empty())
+			item_properties = properties[new_stack.request];
+		pending_placement.active = true;
+		pending_placement.position = new_stack.position;
+		pending_placement.is_rotated = new_stack.is_rotated;
+		int not_added = insert_stack(stacks.size(), item_ids[new_stack.request], new_stack.amount, item_properties, true, false);
+		pending_placement.active = false;
+		leftovers.set(new_stack.request, leftovers[new_stack.request] + not_added);
+	}
+	commit_batch();
+
+	if (!is_batching()) {
+		for (int i = 0; i < item_ids.size(); i++) {
+			int _added = amounts[i] - leftovers[i];
+			if (_added > 0)
+				emit_signal("item_added", item_ids[i], _added);
+		}
+	}
+	return leftovers;
+}
+
 Dictionary GridInventory::serialize() const {
 	Dictionary data = Inventory::serialize();
-	data["stack_positions"] = stack_positions.duplicate();
-	data["stack_rotations"] = stack_rotations.duplicate();
+	// Positions as a packed array and rotations as one bit per stack, low bit first.
+	int count = stack_positions.size();
+	PackedVector2iArray positions;
+	positions.resize(count);
+	Vector2i *position_data = positions.ptrw();
+	for (int i = 0; i < count; i++) {
+		position_data[i] = stack_positions[i];
+	}
+	PackedByteArray rotations;
+	rotations.resize((stack_rotations.size() + 7) / 8);
+	rotations.fill(0);
+	uint8_t *rotation_data = rotations.ptrw();
+	for (int i = 0; i < stack_rotations.size(); i++) {
+		if (bool(stack_rotations[i]))
+			rotation_data[i >> 3] |= uint8_t(1) << (i & 7);
+	}
+	data["stack_positions"] = positions;
+	data["stack_rotations"] = rotations;
 	return data;
 }
 
 void GridInventory::deserialize(const Dictionary data) {
-	Array stack_positions_var = data["stack_positions"];
-	Array stack_rotations_var = data["stack_rotations"];
+	Variant stack_positions_var = data.get("stack_positions", Array());
+	Variant stack_rotations_var = data.get("stack_rotations", Array());
+
+	if (stack_positions_var.get_type() == Variant::PACKED_VECTOR2I_ARRAY && stack_rotations_var.get_type() == Variant::PACKED_BYTE_ARRAY) {
+		Inventory::deserialize(data);
+		_load_placements(stack_positions_var, stack_rotations_var);
+		_rebuild_grid();
+		return;
+	}
+
+	// Saves made before the packed format.
+	Array stack_positions_array = stack_positions_var;
+	Array stack_rotations_array = stack_rotations_var;
 
 	stack_positions.clear();
-	for (size_t i = 0; i < stack_positions_var.size(); i++) {
-		stack_positions.append(stack_positions_var[i]);
+	for (size_t i = 0; i < stack_positions_array.size(); i++) {
+		stack_positions.append(stack_positions_array[i]);
 	}
 
 	stack_rotations.clear();
-	for (size_t i = 0; i < stack_rotations_var.size(); i++) {
-		stack_rotations.append(stack_rotations_var[i]);
+	for (size_t i = 0; i < stack_rotations_array.size(); i++) {
+		stack_rotations.append(stack_rotations_array[i]);
 	}
 
 	Inventory::deserialize(data);
-	for (size_t i = 0; i < stack_positions.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		quad_tree->add(get_stack_rect(stack), stack);
-	}
+	placements_dirty = true;
+	_rebuild_grid();
 }
 
 bool GridInventory::can_add_new_stack(const String &item_id, const int &amount, const Dictionary &properties) const {
+	if (pending_placement.active) {
+		Vector2i footprint = _get_footprint(item_id, pending_placement.is_rotated);
+		PackedInt64Array shape = _get_footprint_shape(item_id, pending_placement.is_rotated);
+		return _footprint_free(pending_placement.position, footprint, shape) && _can_add_on_position(pending_placement.position, item_id, amount, properties, pending_placement.is_rotated) && Inventory::can_add_new_stack(item_id, amount, properties);
+	}
 	return (has_space_in_grid_for(item_id, amount, properties, false) || has_space_in_grid_for(item_id, amount, properties, true)) && Inventory::can_add_new_stack(item_id, amount, properties);
 }
 
@@ -523,10 +1849,16 @@ void GridInventory::on_insert_stack(const int stack_index) {
 	ERR_FAIL_NULL_MSG(definition, "'definition' is null.");
 	bool is_rotated = false;
 	Vector2i position;
-	position = find_free_place(definition->get_size(), stack->get_item_id(), stack->get_amount(), stack->get_properties(), is_rotated);
-	if (position == Vector2i(-1, -1)) {
-		is_rotated = true;
-		position = find_free_place(definition->get_size(), stack->get_item_id(), stack->get_amount(), stack->get_properties(), true);
+	if (pending_placement.active) {
+		position = pending_placement.position;
+		is_rotated = pending_placement.is_rotated;
+		pending_placement.active = false;
+	} else {
+		position = find_free_place(definition->get_size(), stack->get_item_id(), stack->get_amount(), stack->get_properties(), is_rotated);
+		if (position == Vector2i(-1, -1)) {
+			is_rotated = true;
+			position = find_free_place(definition->get_size(), stack->get_item_id(), stack->get_amount(), stack->get_properties(), true);
+		}
 	}
 	stack_positions.insert(stack_index, position);
 	stack_rotations.insert(stack_index, is_rotated);
@@ -536,19 +1868,49 @@ void GridInventory::on_insert_stack(const int stack_index) {
 	} else {
 		size = definition->get_size();
 	}
-	quad_tree->add(Rect2i(position, size), stack);
+	if (!placements_dirty && placements.size() + 1 == stacks.size()) {
+		for (KeyValue<ItemStack *, int> &E : placement_indices) {
+			if (E.value >= stack_index)
+				E.value++;
+		}
+		StackPlacement placement;
+		placement.stack = stack.ptr();
+		placement.position = position;
+		placement.size = size;
+		placement.rotated = is_rotated;
+		placement.shape = definition->get_shape_rows(is_rotated);
+		placements.insert(stack_index, placement);
+		placement_indices.insert(stack.ptr(), stack_index);
+	} else {
+		placements_dirty = true;
+	}
+	_grid_add(Rect2i(position, size), stack, is_rotated);
 }
 
 void GridInventory::on_removed_stack(const Ref<ItemStack> stack, const int stack_index) {
+	Rect2i rect;
+	bool is_rotated = false;
+	if (!placements_dirty && placements.size() == stacks.size() + 1 && placements[stack_index].stack == stack.ptr()) {
+		rect = Rect2i(placements[stack_index].position, placements[stack_index].size);
+		is_rotated = placements[stack_index].rotated;
+		placements.remove_at(stack_index);
+		placement_indices.erase(stack.ptr());
+		for (KeyValue<ItemStack *, int> &E : placement_indices) {
+			if (E.value > stack_index)
+				E.value--;
+		}
+	} else {
+		placements_dirty = true;
+		if (stack != nullptr && stack_index < stack_positions.size()) {
+			is_rotated = stack_rotations[stack_index];
+			rect = Rect2i(stack_positions[stack_index], _get_footprint(stack->get_item_id(), is_rotated));
+		}
+	}
 	stack_positions.remove_at(stack_index);
 	stack_rotations.remove_at(stack_index);
 	if (stack == nullptr)
 		return;
-	quad_tree->remove(stack);
-}
-
-bool GridInventory::_size_check(const Ref<ItemStack> stack1, const Ref<ItemStack> stack2) {
-	return get_stack_size(stack1) == get_stack_size(stack2);
+	_grid_remove(rect, stack, is_rotated);
 }
 
 bool GridInventory::_is_sorted() {
@@ -568,18 +1930,14 @@ bool GridInventory::_is_sorted() {
 }
 
 void GridInventory::_move_stack_to_unsafe(const Ref<ItemStack> &stack, const Vector2i &position) {
-	int stack_index = stacks.find(stack);
+	int stack_index = _get_placement_index(stack);
 	if (stack_index == -1)
 		return;
-	stack_positions[stack_index] = position;
-	quad_tree->remove(stack);
-	quad_tree->add(get_stack_rect(stack), stack);
-}
-
-bool GridInventory::_compare_stacks(const Ref<ItemStack> &stack1, const Ref<ItemStack> &stack2) const {
-	Rect2i rect1 = Rect2i(get_stack_position(stack1), get_stack_size(stack1));
-	Rect2i rect2 = Rect2i(get_stack_position(stack2), get_stack_size(stack2));
-	return rect1.get_area() > rect2.get_area();
+	Rect2i old_rect = get_stack_rect(stack);
+	bool is_rotated = placements[stack_index].rotated;
+	_set_placement_position(stack_index, position);
+	_grid_remove(old_rect, stack, is_rotated);
+	_grid_add(get_stack_rect(stack), stack, is_rotated);
 }
 
 void GridInventory::_sort_if_needed() {
@@ -588,6 +1946,16 @@ void GridInventory::_sort_if_needed() {
 }
 
 bool GridInventory::_can_add_on_position(const Vector2i position, const String item_id, const int amount, const Dictionary properties, const bool is_rotated) const {
+	if (grid_constraints.is_empty())
+		return true;
+	const PlacementMask *mask = _get_placement_mask(item_id, is_rotated);
+	if (mask != nullptr) {
+		if (position.x < 0 || position.y < 0 || position.x >= 64 || position.y >= (int)mask->rows.size())
+			return false;
+		if (((mask->rows[position.y] >> position.x) & 1) == 0)
+			return false;
+		return _passes_dynamic_constraints(mask, position, item_id, amount, properties, is_rotated);
+	}
 	for (size_t i = 0; i < grid_constraints.size(); i++) {
 		Ref<GridInventoryConstraint> grid_constraint = grid_constraints[i];
 		if (grid_constraint != nullptr && !grid_constraint->can_add_on_position(this, position, item_id, amount, properties, is_rotated)) {
@@ -596,3 +1964,46 @@ bool GridInventory::_can_add_on_position(const Vector2i position, const String i
 	}
 	return true;
 }
+
+const GridInventory::PlacementMask *GridInventory::_get_placement_mask(const String &item_id, const bool is_rotated) const {
+	// A row of the mask is a single word, wider grids ask every constraint per cell.
+	if (row_words > 1)
+		return nullptr;
+	int item_handle = _get_item_handle(item_id);
+	if (item_handle == -1)
+		return nullptr;
+	int key = item_handle * 2 + (is_rotated ? 1 : 0);
+	const PlacementMask *cached = placement_masks.getptr(key);
+	if (cached != nullptr)
+		return cached;
+
+	PlacementMask &mask = placement_masks.insert(key, PlacementMask())->value;
+	mask.rows.resize(size.y);
+	for (int y = 0; y < size.y; y++) {
+		mask.rows[y] = _get_row_mask(0, size.x);
+	}
+	for (int i = 0; i < grid_constraints.size(); i++) {
+		Ref<GridInventoryConstraint> grid_constraint = grid_constraints[i];
+		if (grid_constraint == nullptr)
+			continue;
+		if (!grid_constraint->is_position_static(this, item_id)) {
+			mask.dynamic_constraints.push_back(i);
+			continue;
+		}
+		// Rows left out by the constraint allow nothing.
+		PackedInt64Array allowed_positions = grid_constraint->get_allowed_positions(this, item_id, is_rotated);
+		for (int y = 0; y < size.y; y++) {
+			mask.rows[y] &= y < allowed_positions.size() ? uint64_t(allowed_positions[y]) : 0;
+		}
+	}
+	return &mask;
+}
+
+bool GridInventory::_passes_dynamic_constraints(const PlacementMask *mask, const Vector2i position, const String &item_id, const int amount, const Dictionary &properties, const bool is_rotated) const {
+	for (uint32_t i = 0; i < mask->dynamic_constraints.size(); i++) {
+		Ref<GridInventoryConstraint> grid_constraint = grid_constraints[mask->dynamic_constraints[i]];
+		if (grid_constraint != nullptr && !grid_constraint->can_add_on_position(this, position, item_id, amount, properties, is_rotated))
+			return false;
+	}
+	return true;
+}
\ No newline at end of file
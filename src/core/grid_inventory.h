@@ -18,17 +18,179 @@ private:
 	TypedArray<GridInventoryConstraint> grid_constraints;
 	TypedArray<Vector2i> stack_positions;
 	TypedArray<bool> stack_rotations;
+	// Occupancy bitboard, one bit per cell and one word per 64 columns of a row.
+	// Mirrors the quad tree, rect and free place tests run on it. Grids up to 64x64
+	// use the flat array, larger ones are split in 64x64 tiles allocated only where
+	// something lies, so their memory follows the occupied area rather than the grid.
+	uint64_t occupancy[64] = {};
+	struct OccupancyTile {
+		uint64_t rows[64] = {};
+		int used_cells = 0;
+		int next_free = -1;
+	};
+	bool chunked = false;
+	int row_words = 1;
+	// Tile of each 64x64 block of the grid, row by row, -1 while the block is empty.
+	LocalVector<int> tile_table;
+	LocalVector<OccupancyTile> tiles;
+	int free_tile = -1;
+	void _reset_occupancy();
+	int _alloc_tile();
+	void _free_tile(const int tile_index);
+	uint64_t _get_occupancy_word(const int y, const int word) const;
+	bool _is_tile_full(const int y, const int word) const;
+	int _get_free_cells() const;
+	void _copy_occupancy(LocalVector<uint64_t> &r_rows) const;
+	static uint64_t _get_row_mask(const int x, const int width);
+	static uint64_t _get_word_mask(const int word, const int x, const int width);
+	static uint64_t _get_start_candidates(const uint64_t free_columns, const uint64_t next_free_columns, const uint64_t start_columns, const int width);
+	static uint64_t _get_span_start_candidates(const uint64_t *free_words, const int word_count, const int word, const int width);
+	static uint64_t _get_shape_start_candidates(const uint64_t free_columns, const uint64_t next_free_columns, const uint64_t start_columns, const uint64_t shape_row);
+	static uint64_t _get_shifted_word(const uint64_t bits, const int x, const int word);
+	uint64_t _get_start_columns(const int word, const int width) const;
+	void _set_occupancy(const Rect2i &rect, const bool occupied);
+	void _set_occupancy_word(const int y, const int word, const uint64_t mask, const bool occupied);
+	// Shaped stacks only take the cells of their shape rows, placed at the rect position.
+	void _set_footprint_occupancy(const Rect2i &rect, const PackedInt64Array &shape, const bool occupied);
+	// Cells of the stack a test ignores, the shape is empty for rectangular stacks.
+	struct StackException {
+		Rect2i rect;
+		PackedInt64Array shape;
+	};
+	StackException _get_exception(const Ref<ItemStack> &exception) const;
+	uint64_t _get_blocked_columns(const int y, const int height, const int word, const StackException &exception) const;
+	void _get_free_words(const int y, const int height, const StackException &exception, LocalVector<uint64_t> &r_free_words) const;
+	bool _footprint_free(const Vector2i &position, const Vector2i &footprint_size, const PackedInt64Array &shape, const Ref<ItemStack> &exception = nullptr) const;
+	void _grid_add(const Rect2i &rect, const Ref<ItemStack> &stack, const bool is_rotated);
+	void _grid_remove(const Rect2i &rect, const Ref<ItemStack> &stack, const bool is_rotated);
+	// Maximal free rectangles of the grid. Placing a stack splits them in place and
+	// removing one merges its cells back, they are rebuilt from the occupancy when dirty.
+	mutable LocalVector<Rect2i> free_rects;
+	mutable bool free_rects_dirty = true;
+	void _ensure_free_rects() const;
+	void _split_free_rects(const Rect2i &used_rect) const;
+	void _merge_free_rects(const Rect2i &freed_rect) const;
+	void _push_span_free_rects(const uint64_t *span, const uint64_t *above, const uint64_t *below, const int top, const int bottom, const Rect2i &freed, LocalVector<Rect2i> &r_rects) const;
+	static bool _any_columns_set(const uint64_t *bits, const int x, const int width);
+	static bool _all_columns_set(const uint64_t *bits, const int x, const int width);
+	bool _find_free_rect_place(const Vector2i &stack_size, Vector2i &r_position) const;
+	// Last answer of find_free_place, reused while the grid and the query are the same.
+	uint64_t grid_version = 0;
+	struct FreePlaceMemo {
+		int item_handle = -1;
+		bool is_rotated = false;
+		Vector2i stack_size;
+		uint64_t grid_version = 0;
+		Vector2i position;
+	};
+	mutable FreePlaceMemo free_place_memo;
+	// Placement of each stack in stack order, kept in step with stack_positions and
+	// stack_rotations. Rebuilt lazily when those or the stacks are replaced from outside.
+	struct StackPlacement {
+		ItemStack *stack = nullptr;
+		Vector2i position;
+		Vector2i size;
+		bool rotated = false;
+		PackedInt64Array shape;
+	};
+	mutable LocalVector<StackPlacement> placements;
+	mutable HashMap<ItemStack *, int> placement_indices;
+	mutable bool placements_dirty = true;
+	void _rebuild_placements() const;
+	void _fill_placement(const int stack_index, const Vector2i &position, const bool is_rotated) const;
+	// Fast path of deserialize, fills the positions, rotations and placements from the packed data at once.
+	void _load_placements(const PackedVector2iArray &positions, const PackedByteArray &rotations);
+	void _ensure_placements() const;
+	int _get_placement_index(const Ref<ItemStack> &stack) const;
+	Vector2i _get_footprint(const String &item_id, const bool is_rotated) const;
+	PackedInt64Array _get_footprint_shape(const String &item_id, const bool is_rotated) const;
+	bool _placement_intersects(const StackPlacement &placement, const Rect2i &rect) const;
+	static bool _footprints_overlap(const Rect2i &rect, const PackedInt64Array &shape, const Rect2i &other_rect, const PackedInt64Array &other_shape);
+	void _set_placement_position(const int stack_index, const Vector2i &position);
+	void _set_placement_rotation(const int stack_index, const bool is_rotated);
+	// Refreshes size and shape from the stack's item, for when the item itself changed.
+	void _set_placement_footprint(const int stack_index, const bool is_rotated);
+	// Stack to place when packing the grid, with the keys it is ordered by.
+	// The index is the stack index in sort and the new stack index in add_batch.
+	struct PackEntry {
+		int index = 0;
+		Vector2i size;
+		int area = 0;
+		int longest_side = 0;
+		String item_id;
+		int amount = 0;
+		Dictionary properties;
+		PackedInt64Array shape;
+		PackedInt64Array rotated_shape;
+	};
+	struct PackEntryByArea {
+		_FORCE_INLINE_ bool operator()(const PackEntry &a, const PackEntry &b) const {
+			if (a.area != b.area)
+				return a.area > b.area;
+			if (a.longest_side != b.longest_side)
+				return a.longest_side > b.longest_side;
+			return a.index < b.index;
+		}
+	};
+	struct PackEntryBySide {
+		_FORCE_INLINE_ bool operator()(const PackEntry &a, const PackEntry &b) const {
+			if (a.longest_side != b.longest_side)
+				return a.longest_side > b.longest_side;
+			if (a.area != b.area)
+				return a.area > b.area;
+			return a.index < b.index;
+		}
+	};
+	int _pack_entries(const LocalVector<PackEntry> &entries, const LocalVector<uint64_t> &initial_rows, LocalVector<Vector2i> &r_positions, LocalVector<bool> &r_rotations) const;
+	Vector2i _find_pack_place(const LocalVector<uint64_t> &rows, const Vector2i stack_size, const PackEntry &entry, const bool is_rotated, const int max_y) const;
+	// Outcome of planning add_batch: amounts merged into existing stacks, then new
+	// stacks with the cells they were packed on. Leftovers are per request.
+	struct BatchMerge {
+		int request = 0;
+		int stack_index = 0;
+		int amount = 0;
+	};
+	struct BatchStack {
+		int request = 0;
+		int amount = 0;
+		Vector2i position;
+		bool is_rotated = false;
+	};
+	struct BatchPlan {
+		PackedInt32Array leftovers;
+		LocalVector<BatchMerge> merges;
+		LocalVector<BatchStack> new_stacks;
+	};
+	void _plan_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties, const float time_budget_msec, BatchPlan &r_plan) const;
+	// Cell the next inserted stack takes instead of searching one, set while add_batch commits.
+	struct PendingPlacement {
+		bool active = false;
+		Vector2i position;
+		bool is_rotated = false;
+	};
+	PendingPlacement pending_placement;
 	bool _bounds_broken() const;
 	void _refresh_quad_tree();
-	bool _size_check(const Ref<ItemStack> stack1, const Ref<ItemStack> stack2);
+	void _rebuild_grid();
 	bool _is_sorted();
 	void _move_stack_to_unsafe(const Ref<ItemStack> &stack, const Vector2i &position);
-	bool _compare_stacks(const Ref<ItemStack> &stack1, const Ref<ItemStack> &stack2) const;
 	void _sort_if_needed();
 	bool _can_add_on_position(const Vector2i position, const String item_id, const int amount, const Dictionary properties, const bool is_rotated) const;
+	// Allowed top-left cells, one word per row, from the position-static constraints
+	// of an item and orientation. The other constraints are still asked per cell.
+	// Only built for grids up to 64 columns wide.
+	struct PlacementMask {
+		LocalVector<uint64_t> rows;
+		LocalVector<int> dynamic_constraints;
+	};
+	mutable HashMap<int, PlacementMask> placement_masks;
+	const PlacementMask *_get_placement_mask(const String &item_id, const bool is_rotated) const;
+	Vector2i _scan_free_place(const Vector2i &final_size, const PackedInt64Array &shape, const PlacementMask *mask, const StackException &exception, const String &item_id, const int amount, const Dictionary &properties, const bool is_rotated, uint8_t *r_map = nullptr) const;
+	bool _passes_dynamic_constraints(const PlacementMask *mask, const Vector2i position, const String &item_id, const int amount, const Dictionary &properties, const bool is_rotated) const;
 
 protected:
 	static void _bind_methods();
+	virtual void _invalidate_item_stacks_index() override;
 
 public:
 	virtual void _enter_tree() override;
@@ -39,6 +201,7 @@ public:
 	Vector2i get_size() const;
 	void set_grid_constraints(const TypedArray<GridInventoryConstraint> &new_grid_constraints);
 	TypedArray<GridInventoryConstraint> get_grid_constraints() const;
+	void refresh_constraint_masks();
 	void set_quad_tree(const Ref<QuadTree> &new_quad_tree);
 	Ref<QuadTree> get_quad_tree() const;
 	void set_stack_positions(const TypedArray<Vector2i> &new_stack_positions);
@@ -66,7 +229,10 @@ public:
 	bool rect_free(const Rect2i &rect, const Ref<ItemStack> &exception = nullptr) const;
 	Vector2i find_free_place(const Vector2i stack_size, const String item_id, const int amount, const Dictionary properties, const bool is_rotated, const Ref<ItemStack> &exception = nullptr) const;
 	bool has_free_place(const Vector2i stack_size, const Ref<ItemStack> &exception = nullptr) const;
+	PackedByteArray get_placement_map(const String &item_id, const bool is_rotated = false, const Dictionary &properties = Dictionary()) const;
 	bool sort();
+	PackedInt32Array plan_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties = Array(), const float time_budget_msec = 0) const;
+	PackedInt32Array add_batch(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties = Array(), const float time_budget_msec = 0);
 	virtual Dictionary serialize() const override;
 	virtual void deserialize(const Dictionary data) override;
 	virtual bool can_add_new_stack(const String &item_id, const int &amount, const Dictionary &properties) const override;
@@ -20,30 +20,21 @@ void Inventory::set_stack_content(const int stack_index, const String &item_id,
 
 	int old_amount = this->amount();
 	Ref<ItemStack> stack = stacks[stack_index];
-	stack->set_item_id(item_id);
-	stack->set_amount(amount);
-	stack->set_properties(properties);
+	String old_item_id = stack->get_item_id();
+	int old_stack_amount = stack->get_amount();
+	stack->set_content(item_id, _get_item_handle(item_id), amount, properties, !is_batching());
 	stacks[stack_index] = stack;
-	emit_signal("updated_stack", stack_index);
+	stacks_edit_revision++;
+	_reindex_stack(stack_index, old_item_id, old_stack_amount);
+	_record_batch_change(stack, old_item_id, old_stack_amount, item_id, amount);
+	if (!is_batching())
+		emit_signal("updated_stack", stack_index);
 	_call_events(old_amount);
 }
 
 bool Inventory::is_empty() const {
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-
-		if (stack == nullptr) {
-			continue;
-		}
-
-		// short circuit and return the moment we find any amount
-		if (stack->get_amount() > 0) {
-			return false;
-		}
-	}
-
-	// did not find any amount inventory is empty
-	return true;
+	_ensure_item_stacks_index();
+	return indexed_amount <= 0;
 }
 
 bool Inventory::is_full() const {
@@ -52,13 +43,8 @@ bool Inventory::is_full() const {
 		return false;
 	}
 
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		Ref<ItemDefinition> definition = get_database()->get_item(stack->get_item_id());
-		if (definition != nullptr && stack->get_amount() < definition->get_max_stack())
-			return false;
-	}
-	return true;
+	// full when no stack of a known item has room left
+	return indexed_stacks_with_room == 0;
 }
 
 void Inventory::clear() {
@@ -71,17 +57,9 @@ void Inventory::clear() {
 bool Inventory::contains(const String &item_id, const int &amount) const {
 	ERR_FAIL_COND_V_MSG(amount < 0, false, "'amount' is negative.");
 
-	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (stack->get_item_id() == item_id) {
-			amount_in_inventory += stack->get_amount();
-			if (amount_in_inventory >= amount) {
-				return true;
-			}
-		}
-	}
-	return false;
+	bool found = false;
+	int amount_in_inventory = _get_item_amount(_get_item_handle(item_id), item_id, found);
+	return found && amount_in_inventory >= amount;
 }
 
 bool Inventory::contains_at(const int &stack_index, const String &item_id, const int &amount) const {
@@ -100,12 +78,21 @@ bool Inventory::contains_at(const int &stack_index, const String &item_id, const
 bool Inventory::contains_category(const Ref<ItemCategory> &category, const int &amount) const {
 	ERR_FAIL_NULL_V_MSG(category, false, "'category' is null.");
 	ERR_FAIL_COND_V_MSG(amount < 0, false, "The 'amount' is negative.");
+	Ref<InventoryDatabase> database = get_database();
+	ERR_FAIL_NULL_V_MSG(database, false, "'database' is null.");
 
+	if (category->get_index() >= 0) {
+		const CategoryStacks *category_stacks = _get_category_stacks(category);
+		return category_stacks != nullptr && category_stacks->stack_count > 0 && category_stacks->amount >= amount;
+	}
+
+	// Categories outside the database have no index, walk the stacks.
+	_ensure_item_stacks_index();
 	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (contains_category_in_stack(stack, category)) {
-			amount_in_inventory += stack->get_amount();
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		Ref<ItemDefinition> definition = database->get_item_from_handle(stack_item_handles[i]);
+		if (definition != nullptr && definition->is_in_category(category)) {
+			amount_in_inventory += stack_amounts[i];
 			if (amount_in_inventory >= amount) {
 				return true;
 			}
@@ -120,17 +107,18 @@ bool Inventory::has_space_for(const String &item_id, const int amount, const Dic
 
 bool Inventory::can_stack_with_actual_slots(const String &item_id, const int amount, const Dictionary &properties) const {
 	ERR_FAIL_NULL_V_MSG(get_database(), false, "'database' is null.");
-	Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+	int item_handle = _get_item_handle(item_id);
+	Ref<ItemDefinition> definition = get_database()->get_item_from_handle(item_handle);
 	ERR_FAIL_NULL_V_MSG(definition, false, "'definition' is null.");
 	int amount_in_interaction = amount;
 
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (stack->get_item_id() == item_id) {
-			amount_in_interaction -= definition->get_max_stack() - stack->get_amount();
-			if (amount_in_interaction <= 0) {
-				return true;
-			}
+	LocalVector<int> stack_indices;
+	_get_stack_indices_of_item(item_handle, item_id, stack_indices);
+	for (uint32_t i = 0; i < stack_indices.size(); i++) {
+		Ref<ItemStack> stack = stacks[stack_indices[i]];
+		amount_in_interaction -= definition->get_max_stack() - stack->get_amount();
+		if (amount_in_interaction <= 0) {
+			return true;
 		}
 	}
 	return false;
@@ -146,11 +134,21 @@ bool Inventory::has_stack(const Ref<ItemStack> &stack) const {
 
 int Inventory::get_stack_index_with_an_item_of_category(const Ref<ItemCategory> &category) const {
 	ERR_FAIL_NULL_V_MSG(category, 0, "'category' is null.");
+	Ref<InventoryDatabase> database = get_database();
+	ERR_FAIL_NULL_V_MSG(database, -1, "'database' is null.");
+
+	if (category->get_index() >= 0) {
+		_ensure_stack_positions();
+		const CategoryStacks *category_stacks = _get_category_stacks(category);
+		if (category_stacks == nullptr || category_stacks->stack_indices.is_empty())
+			return -1;
+		return category_stacks->stack_indices[0];
+	}
 
-	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (contains_category_in_stack(stack, category)) {
+	_ensure_item_stacks_index();
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		Ref<ItemDefinition> definition = database->get_item_from_handle(stack_item_handles[i]);
+		if (definition != nullptr && definition->is_in_category(category)) {
 			return i;
 		}
 	}
@@ -158,42 +156,34 @@ int Inventory::get_stack_index_with_an_item_of_category(const Ref<ItemCategory>
 }
 
 int Inventory::amount_of_item(const String &item_id) const {
-	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (stack->contains(item_id, 1)) {
-			amount_in_inventory += stack->get_amount();
-		}
-	}
-	return amount_in_inventory;
+	bool found = false;
+	return _get_item_amount(_get_item_handle(item_id), item_id, found);
 }
 
 int Inventory::amount_of_category(const Ref<ItemCategory> &category) const {
 	ERR_FAIL_NULL_V_MSG(category, 0, "'category' is null.");
+	Ref<InventoryDatabase> database = get_database();
+	ERR_FAIL_NULL_V_MSG(database, 0, "'database' is null.");
 
+	if (category->get_index() >= 0) {
+		const CategoryStacks *category_stacks = _get_category_stacks(category);
+		return category_stacks != nullptr ? category_stacks->amount : 0;
+	}
+
+	_ensure_item_stacks_index();
 	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (stack == nullptr) {
-			continue;
-		}
-		if (contains_category_in_stack(stack, category)) {
-			amount_in_inventory += stack->get_amount();
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		Ref<ItemDefinition> definition = database->get_item_from_handle(stack_item_handles[i]);
+		if (definition != nullptr && definition->is_in_category(category)) {
+			amount_in_inventory += stack_amounts[i];
 		}
 	}
 	return amount_in_inventory;
 }
 
 int Inventory::amount() const {
-	int amount_in_inventory = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		if (stack == nullptr) {
-			continue;
-		}
-		amount_in_inventory += stack->get_amount();
-	}
-	return amount_in_inventory;
+	_ensure_item_stacks_index();
+	return indexed_amount;
 }
 
 int Inventory::add(const String &item_id, const int &amount, const Dictionary &properties, const bool &drop_excess, const bool can_emit_item_added_signal) {
@@ -201,10 +191,14 @@ int Inventory::add(const String &item_id, const int &amount, const Dictionary &p
 
 	int amount_in_interact = amount;
 	int old_amount = this->amount();
+	int item_handle = _get_item_handle(item_id);
 
+	_ensure_item_stacks_index();
 	for (size_t i = 0; i < stacks.size(); i++) {
+		if (_can_skip_stack_for_item(i, item_handle))
+			continue;
 		int previous_amount = amount_in_interact;
-		amount_in_interact = _add_to_stack(i, item_id, amount_in_interact, properties, can_emit_item_added_signal);
+		amount_in_interact = _add_to_stack(i, item_id, item_handle, amount_in_interact, properties, can_emit_item_added_signal);
 
 		// Check for potential integer underflow
 		ERR_FAIL_COND_V_MSG(amount_in_interact > previous_amount, amount, "Integer underflow detected in _add_to_slot.");
@@ -232,7 +226,7 @@ int Inventory::add(const String &item_id, const int &amount, const Dictionary &p
 
 	if (_added > 0) {
 		_flag_contents_changed = true;
-		if (can_emit_item_added_signal) {
+		if (can_emit_item_added_signal && !is_batching()) {
 			this->emit_signal("item_added", item_id, _added);
 		}
 	}
@@ -252,13 +246,13 @@ int Inventory::add_at_index(const int &stack_index, const String &item_id, const
 	int amount_in_interact = amount;
 	int old_amount = this->amount();
 	if (stack_index < stacks.size()) {
-		amount_in_interact = _add_to_stack(stack_index, item_id, amount_in_interact, properties, can_emit_item_added_signal);
+		amount_in_interact = _add_to_stack(stack_index, item_id, _get_item_handle(item_id), amount_in_interact, properties, can_emit_item_added_signal);
 		_call_events(old_amount);
 	}
 	int _added = amount - amount_in_interact;
 	if (_added > 0) {
 		_flag_contents_changed = true;
-		if (can_emit_item_added_signal) {
+		if (can_emit_item_added_signal && !is_batching()) {
 			this->emit_signal("item_added", item_id, _added);
 		}
 	}
@@ -290,7 +284,7 @@ int Inventory::add_on_new_stack(const String &item_id, const int &amount, const
 	int _added = amount - no_added;
 	if (_added > 0) {
 		_flag_contents_changed = true;
-		if (can_emit_item_added_signal) {
+		if (can_emit_item_added_signal && !is_batching()) {
 			this->emit_signal("item_added", item_id, _added);
 		}
 	}
@@ -301,23 +295,28 @@ int Inventory::insert_stack(const int &stack_index, const String &item_id, const
 	if (!can_add_new_stack(item_id, amount, properties))
 		return amount;
 
+	int item_handle = _get_item_handle(item_id);
 	Ref<ItemStack> stack = memnew(ItemStack());
 	stacks.append(stack);
-	stack->set_item_id(item_id);
 
-	int max_stack = _get_max_stack_for_stack(item_id, amount, properties);
+	int max_stack = _get_max_stack_for_stack(item_handle, item_id, amount, properties);
 	int amount_to_add = MIN(amount, max_stack - stack->get_amount());
 
-	stack->set_amount(amount_to_add);
-	stack->set_properties(properties);
+	stack->set_content(item_id, item_handle, amount_to_add, properties, !is_batching());
+	_watch_stack(stack);
+	_on_indexed_stack_inserted(stacks.size() - 1);
+	if (!item_id.is_empty())
+		_index_stack(stacks.size() - 1, item_handle, amount_to_add);
+	_cache_stack(stacks.size() - 1, stack);
+	_record_batch_change(stack, "", 0, item_id, amount_to_add);
 	// int no_added = add_at_index(stacks.size() - 1, item_id, amount, properties);
 	on_insert_stack(stack_index);
 
-	if (can_emit_stack_added_signal) {
+	if (can_emit_stack_added_signal && !is_batching()) {
 		this->emit_signal("stack_added", stacks.size() - 1);
 	}
 
-	if (can_emit_item_added_signal) {
+	if (can_emit_item_added_signal && !is_batching()) {
 		this->emit_signal("item_added", item_id, amount_to_add);
 	}
 
@@ -326,6 +325,11 @@ int Inventory::insert_stack(const int &stack_index, const String &item_id, const
 
 void Inventory::remove_stack(const int &stack_index) {
 	int old_amount = this->amount();
+	if (stack_index >= 0 && stack_index < stacks.size()) {
+		Ref<ItemStack> stack = stacks[stack_index];
+		if (stack != nullptr && stack->get_amount() > 0)
+			stacks_edit_revision++;
+	}
 	_remove_stack_at(stack_index);
 	_call_events(old_amount);
 }
@@ -335,20 +339,32 @@ int Inventory::remove(const String &item_id, const int &amount) {
 
 	int amount_in_interact = amount;
 	int old_amount = this->amount();
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		amount_in_interact = _remove_from_stack(i, item_id, amount_in_interact);
-		if (stack->get_amount() == 0) {
-			_remove_stack_at(i);
-			_call_events(old_amount);
-		}
-		if (amount_in_interact == 0) {
-			break;
+	int item_handle = _get_item_handle(item_id);
+	// Copied because emptied stacks are removed, shifting the index, while walking it.
+	LocalVector<int> stack_indices;
+	_get_stack_indices_of_item(item_handle, item_id, stack_indices);
+	if (!stack_indices.is_empty()) {
+		int removed_stacks = 0;
+		for (uint32_t i = 0; i < stack_indices.size(); i++) {
+			int stack_index = stack_indices[i] - removed_stacks;
+			if (stack_index < 0 || stack_index >= stacks.size())
+				break;
+			Ref<ItemStack> stack = stacks[stack_index];
+			amount_in_interact = _remove_from_stack(stack_index, item_id, item_handle, amount_in_interact);
+			if (stack->get_amount() == 0) {
+				_remove_stack_at(stack_index);
+				removed_stacks++;
+				_call_events(old_amount);
+			}
+			if (amount_in_interact == 0) {
+				break;
+			}
 		}
 	}
 	int _removed = amount - amount_in_interact;
 	if (_removed > 0) {
-		emit_signal("item_removed", item_id, _removed);
+		if (!is_batching())
+			emit_signal("item_removed", item_id, _removed);
 		_flag_contents_changed = true;
 	}
 	return amount_in_interact;
@@ -362,7 +378,7 @@ int Inventory::remove_at(const int &stack_index, const String &item_id, const in
 	int old_amount = this->amount();
 	if (stack_index < stacks.size()) {
 		Ref<ItemStack> stack = stacks[stack_index];
-		amount_in_interact = _remove_from_stack(stack_index, item_id, amount_in_interact);
+		amount_in_interact = _remove_from_stack(stack_index, item_id, _get_item_handle(item_id), amount_in_interact);
 		if (stack->get_amount() == 0) {
 			_remove_stack_at(stack_index);
 			_call_events(old_amount);
@@ -370,12 +386,144 @@ int Inventory::remove_at(const int &stack_index, const String &item_id, const in
 	}
 	int _removed = amount - amount_in_interact;
 	if (_removed > 0) {
-		emit_signal("item_removed", item_id, _removed);
+		if (!is_batching())
+			emit_signal("item_removed", item_id, _removed);
 		_flag_contents_changed = true;
 	}
 	return amount_in_interact;
 }
 
+PackedInt32Array Inventory::add_many(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties) {
+	PackedInt32Array leftovers = amounts;
+	ERR_FAIL_COND_V_MSG(item_ids.size() != amounts.size(), leftovers, "The 'item_ids' and 'amounts' sizes differ.");
+	ERR_FAIL_COND_V_MSG(!properties.is_empty() && properties.size() != item_ids.size(), leftovers, "The 'properties' must be empty or the same size as 'item_ids'.");
+
+	// Resolve every request once and group them by item, so stacks are walked a single time.
+	const int count = item_ids.size();
+	LocalVector<int> item_handles;
+	LocalVector<Dictionary> item_properties;
+	item_handles.resize(count);
+	item_properties.resize(count);
+	HashMap<String, LocalVector<int>> requests_by_item;
+	int pending = 0;
+	for (int i = 0; i < count; i++) {
+		ERR_CONTINUE_MSG(amounts[i] < 0, "The 'amount' is negative.");
+		item_handles[i] = _get_item_handle(item_ids[i]);
+		if (!properties.is_empty())
+			item_properties[i] = properties[i];
+		if (amounts[i] == 0)
+			continue;
+		LocalVector<int> *requests = requests_by_item.getptr(item_ids[i]);
+		if (requests == nullptr)
+			requests = &requests_by_item.insert(item_ids[i], LocalVector<int>())->value;
+		requests->push_back(i);
+		pending++;
+	}
+
+	begin_batch();
+	for (int stack_index = 0; stack_index < stacks.size() && pending > 0; stack_index++) {
+		Ref<ItemStack> stack = stacks[stack_index];
+		if (stack == nullptr)
+			continue;
+		// A free stack takes the first request that fits, then the same item keeps stacking below.
+		for (int i = 0; i < count && !stack->has_valid(); i++) {
+			if (leftovers[i] <= 0)
+				continue;
+			leftovers.set(i, _add_to_stack(stack_index, item_ids[i], item_handles[i], leftovers[i], item_properties[i], false));
+			if (leftovers[i] == 0)
+				pending--;
+		}
+		if (!stack->has_valid())
+			continue;
+		LocalVector<int> *requests = requests_by_item.getptr(stack->get_item_id());
+		if (requests == nullptr)
+			continue;
+		for (uint32_t r = 0; r < requests->size(); r++) {
+			int i = (*requests)[r];
+			if (leftovers[i] <= 0)
+				continue;
+			leftovers.set(i, _add_to_stack(stack_index, item_ids[i], item_handles[i], leftovers[i], item_properties[i], false));
+			if (leftovers[i] == 0)
+				pending--;
+		}
+	}
+	for (int i = 0; i < count && pending > 0; i++) {
+		if (leftovers[i] <= 0)
+			continue;
+		leftovers.set(i, add_on_new_stack(item_ids[i], leftovers[i], item_properties[i], true, false));
+		if (leftovers[i] == 0)
+			pending--;
+	}
+	commit_batch();
+
+	if (!is_batching()) {
+		for (int i = 0; i < count; i++) {
+			int _added = amounts[i] - leftovers[i];
+			if (_added > 0)
+				emit_signal("item_added", item_ids[i], _added);
+		}
+	}
+	return leftovers;
+}
+
+PackedInt32Array Inventory::remove_many(const PackedStringArray &item_ids, const PackedInt32Array &amounts) {
+	PackedInt32Array leftovers = amounts;
+	ERR_FAIL_COND_V_MSG(item_ids.size() != amounts.size(), leftovers, "The 'item_ids' and 'amounts' sizes differ.");
+
+	const int count = item_ids.size();
+	LocalVector<int> item_handles;
+	item_handles.resize(count);
+	HashMap<String, LocalVector<int>> requests_by_item;
+	int pending = 0;
+	for (int i = 0; i < count; i++) {
+		ERR_CONTINUE_MSG(amounts[i] < 0, "The 'amount' is negative.");
+		item_handles[i] = _get_item_handle(item_ids[i]);
+		if (amounts[i] == 0)
+			continue;
+		LocalVector<int> *requests = requests_by_item.getptr(item_ids[i]);
+		if (requests == nullptr)
+			requests = &requests_by_item.insert(item_ids[i], LocalVector<int>())->value;
+		requests->push_back(i);
+		pending++;
+	}
+
+	begin_batch();
+	for (int stack_index = 0; stack_index < stacks.size() && pending > 0; stack_index++) {
+		Ref<ItemStack> stack = stacks[stack_index];
+		if (stack == nullptr)
+			continue;
+		LocalVector<int> *requests = requests_by_item.getptr(stack->get_item_id());
+		if (requests == nullptr)
+			continue;
+		for (uint32_t r = 0; r < requests->size() && stack->get_amount() > 0; r++) {
+			int i = (*requests)[r];
+			if (leftovers[i] <= 0)
+				continue;
+			leftovers.set(i, _remove_from_stack(stack_index, item_ids[i], item_handles[i], leftovers[i]));
+			if (leftovers[i] == 0)
+				pending--;
+		}
+		if (stack->get_amount() == 0) {
+			_remove_stack_at(stack_index);
+			stack_index--;
+		}
+	}
+	commit_batch();
+
+	int _removed_total = 0;
+	for (int i = 0; i < count; i++) {
+		int _removed = amounts[i] - leftovers[i];
+		if (_removed <= 0)
+			continue;
+		_removed_total += _removed;
+		if (!is_batching())
+			emit_signal("item_removed", item_ids[i], _removed);
+	}
+	if (_removed_total > 0)
+		_flag_contents_changed = true;
+	return leftovers;
+}
+
 bool Inventory::split(const int &stack_index, const int &amount) {
 	ERR_FAIL_COND_V_MSG(stack_index < 0 || stack_index >= stacks.size(), false, "The 'stack index' is out of bounds.");
 
@@ -456,7 +604,11 @@ int Inventory::transfer(const int &stack_index, Inventory *destination, const in
 }
 
 void Inventory::set_stacks(const TypedArray<ItemStack> &new_items) {
+	_unwatch_stacks();
 	stacks = new_items;
+	_watch_stacks();
+	stacks_edit_revision++;
+	_invalidate_item_stacks_index();
 }
 
 TypedArray<ItemStack> Inventory::get_stacks() const {
@@ -489,6 +641,9 @@ void Inventory::deserialize(const Dictionary data) {
 	ERR_FAIL_COND_MSG(!data.has("items"), "Data to deserialize is invalid: Does not contain the 'items' field");
 	Array items_data = data["items"];
 	get_database()->deserialize_item_stacks(stacks, items_data);
+	_watch_stacks();
+	stacks_edit_revision++;
+	_invalidate_item_stacks_index();
 }
 
 bool Inventory::can_add_new_stack(const String &item_id, const int &amount, const Dictionary &properties) const {
@@ -529,27 +684,30 @@ void Inventory::drop_from_inventory(const int &stack_index, const int &amount, c
 }
 
 int Inventory::add_to_stack(Ref<ItemStack> stack, const String &item_id, const int &amount, const Dictionary &properties, const bool can_emit_item_added_signal) {
+	// The stack may be one of ours, its position is unknown here.
+	_invalidate_item_stacks_index();
+	return _add_to_item_stack(stack, item_id, _get_item_handle(item_id), amount, properties, can_emit_item_added_signal);
+}
+
+int Inventory::_add_to_item_stack(Ref<ItemStack> stack, const String &item_id, const int item_handle, const int amount, const Dictionary &properties, const bool can_emit_item_added_signal) {
 	ERR_FAIL_COND_V_MSG(amount < 0, 0, "The 'amount' is negative.");
 
 	if (amount <= 0)
 		return amount;
 
-	if (stack->has_valid() && (stack->get_item_id() != item_id || stack->get_properties() != properties))
+	if (stack->has_valid() && (!_stack_has_item(stack, item_handle, item_id) || stack->get_properties() != properties))
 		return amount;
 
 	if (!_can_add_on_inventory_from_constraints(item_id, amount, properties))
 		return amount;
 
 	int amount_to_add = _get_amount_to_add_from_constraints(item_id, amount, properties);
-	int max_stack = _get_max_stack_for_stack(item_id, amount, properties);
+	int max_stack = _get_max_stack_for_stack(item_handle, item_id, amount, properties);
 
 	amount_to_add = MIN(amount_to_add, max_stack - stack->get_amount());
-	stack->set_amount(stack->get_amount() + amount_to_add);
-	stack->set_item_id(item_id);
-	stack->set_properties(properties);
-	stack->emit_signal("updated");
+	stack->set_content(item_id, item_handle, stack->get_amount() + amount_to_add, properties, !is_batching());
 
-	if (can_emit_item_added_signal) {
+	if (can_emit_item_added_signal && !is_batching()) {
 		this->emit_signal("item_added", item_id, amount_to_add);
 	}
 
@@ -557,15 +715,19 @@ int Inventory::add_to_stack(Ref<ItemStack> stack, const String &item_id, const i
 }
 
 int Inventory::remove_from_stack(Ref<ItemStack> stack, const String &item_id, const int &amount) {
+	_invalidate_item_stacks_index();
+	return _remove_from_item_stack(stack, item_id, _get_item_handle(item_id), amount);
+}
+
+int Inventory::_remove_from_item_stack(Ref<ItemStack> stack, const String &item_id, const int item_handle, const int amount) {
 	if (stack->get_item_id() == "") {
 		return amount;
 	}
-	if (amount <= 0 || stack->get_item_id() != item_id) {
+	if (amount <= 0 || !_stack_has_item(stack, item_handle, item_id)) {
 		return amount;
 	}
 	int amount_to_remove = MIN(amount, stack->get_amount());
-	stack->set_amount(stack->get_amount() - amount_to_remove);
-	stack->emit_signal("updated");
+	stack->set_content(stack->get_item_id(), stack->get_item_handle(), stack->get_amount() - amount_to_remove, stack->get_properties(), !is_batching());
 	return amount - amount_to_remove;
 }
 
@@ -578,7 +740,7 @@ int Inventory::get_max_stack_of_stack(const Ref<ItemStack> &stack, Ref<ItemDefin
 }
 
 bool Inventory::contains_category_in_stack(const Ref<ItemStack> &stack, const Ref<ItemCategory> &category) const {
-	Ref<ItemDefinition> definition = get_database()->get_item(stack->get_item_id());
+	Ref<ItemDefinition> definition = _get_stack_definition(stack);
 	if (definition == nullptr) {
 		return false;
 	} else {
@@ -587,26 +749,21 @@ bool Inventory::contains_category_in_stack(const Ref<ItemStack> &stack, const Re
 }
 
 float Inventory::get_weight() const {
-	float weight = 0;
-	for (size_t i = 0; i < stacks.size(); i++) {
-		Ref<ItemStack> stack = stacks[i];
-		Ref<ItemDefinition> definition = get_database()->get_item(stack->get_item_id());
-		if (definition != nullptr) {
-			weight += definition->get_weight() * stack->get_amount();
-		}
-	}
-	return weight;
+	_ensure_item_stacks_index();
+	return indexed_weight;
 }
 
 void Inventory::_insert_stack(int stack_index) {
 	ERR_FAIL_COND_MSG(stack_index < 0 || stack_index > stacks.size(), "The 'stack index' is out of bounds.");
 
 	Ref<ItemStack> stack = memnew(ItemStack());
-	stack->set_item_id("");
-	stack->set_amount(0);
 	stacks.insert(stack_index, stack);
+	_watch_stack(stack);
+	_on_indexed_stack_inserted(stack_index);
+	_record_batch_change(stack, "", 0, "", 0);
 	on_insert_stack(stack_index);
-	this->emit_signal("stack_added", stack_index);
+	if (!is_batching())
+		this->emit_signal("stack_added", stack_index);
 }
 
 void Inventory::_remove_stack_at(int stack_index) {
@@ -614,11 +771,22 @@ void Inventory::_remove_stack_at(int stack_index) {
 
 	Ref<ItemStack> stack_removed = stacks[stack_index];
 	stacks.remove_at(stack_index);
+	_unwatch_stack(stack_removed);
+	if (stack_removed != nullptr) {
+		if (!stack_removed->get_item_id().is_empty())
+			_unindex_stack(stack_index, _get_stack_item_handle(stack_removed), stack_removed->get_amount());
+		_record_batch_change(stack_removed, stack_removed->get_item_id(), stack_removed->get_amount(), "", 0);
+	}
+	_on_indexed_stack_removed(stack_index);
 	on_removed_stack(stack_removed, stack_index);
-	this->emit_signal("stack_removed", stack_index);
+	if (!is_batching())
+		this->emit_signal("stack_removed", stack_index);
 }
 
 void Inventory::_call_events(int old_amount) {
+	// Deferred to commit_batch.
+	if (is_batching())
+		return;
 	int actual_amount = amount();
 	if (old_amount != actual_amount) {
 		_flag_contents_changed = true;
@@ -631,44 +799,419 @@ void Inventory::_call_events(int old_amount) {
 	}
 }
 
-int Inventory::_add_to_stack(int stack_index, const String &item_id, int amount, const Dictionary &properties, const bool can_emit_item_added_signal) {
+int Inventory::_add_to_stack(int stack_index, const String &item_id, const int item_handle, int amount, const Dictionary &properties, const bool can_emit_item_added_signal) {
 	ERR_FAIL_COND_V_MSG(amount < 0, amount, "The 'amount' is negative.");
 	ERR_FAIL_COND_V_MSG(stack_index < 0 || stack_index >= stacks.size(), amount, "The 'slot index' is out of bounds.");
 
 	Ref<ItemStack> stack = stacks[stack_index];
 	ERR_FAIL_NULL_V_MSG(stack, amount, "The 'stack' is null.");
 
-	int _remaining_amount = add_to_stack(stack, item_id, amount, properties, can_emit_item_added_signal);
+	String old_item_id = stack->get_item_id();
+	int old_stack_amount = stack->get_amount();
+	int _remaining_amount = _add_to_item_stack(stack, item_id, item_handle, amount, properties, can_emit_item_added_signal);
 
 	if (_remaining_amount == amount) {
 		return amount;
 	}
+	_reindex_stack(stack_index, old_item_id, old_stack_amount);
+	_record_batch_change(stack, old_item_id, old_stack_amount, stack->get_item_id(), stack->get_amount());
 
-	emit_signal("updated_stack", stack_index);
+	if (!is_batching())
+		emit_signal("updated_stack", stack_index);
 	return _remaining_amount;
 }
 
-int Inventory::_remove_from_stack(int stack_index, const String &item_id, int amount) {
+int Inventory::_remove_from_stack(int stack_index, const String &item_id, const int item_handle, int amount) {
 	ERR_FAIL_COND_V_MSG(stack_index < 0 || stack_index >= stacks.size(), amount, "The 'slot index' is out of bounds.");
 	ERR_FAIL_COND_V_MSG(amount < 0, amount, "The 'amount' is negative.");
 
 	Ref<ItemStack> stack = stacks[stack_index];
-	int _remaining_amount = remove_from_stack(stack, item_id, amount);
+	int old_stack_amount = stack->get_amount();
+	int _remaining_amount = _remove_from_item_stack(stack, item_id, item_handle, amount);
 	if (_remaining_amount == amount) {
 		return amount;
 	}
-	emit_signal("updated_stack", stack_index);
+	_reindex_stack(stack_index, stack->get_item_id(), old_stack_amount);
+	_record_batch_change(stack, stack->get_item_id(), old_stack_amount, stack->get_item_id(), stack->get_amount());
+	if (!is_batching())
+		emit_signal("updated_stack", stack_index);
 	return _remaining_amount;
 }
 
 int Inventory::_get_max_stack_for_stack(const String item_id, const int amount, const Dictionary properties) const {
+	return _get_max_stack_for_stack(_get_item_handle(item_id), item_id, amount, properties);
+}
+
+int Inventory::_get_max_stack_for_stack(const int item_handle, const String item_id, const int amount, const Dictionary properties) const {
 	ERR_FAIL_NULL_V_MSG(get_database(), amount, "The 'database' is null.");
-	Ref<ItemDefinition> definition = get_database()->get_item(item_id);
+	Ref<ItemDefinition> definition = get_database()->get_item_from_handle(item_handle);
 	ERR_FAIL_NULL_V_MSG(definition, amount, "The 'definition' is null.");
 	int max_stack = _get_max_stack_from_constraints(item_id, amount, properties, definition->get_max_stack());
 	return max_stack;
 }
 
+int Inventory::_get_item_handle(const String &item_id) const {
+	if (get_database().is_null())
+		return -1;
+	return get_database()->get_item_handle(item_id);
+}
+
+int Inventory::_get_stack_item_handle(const Ref<ItemStack> &stack) const {
+	int item_handle = stack->get_item_handle();
+	if (item_handle < 0 && !stack->get_item_id().is_empty()) {
+		item_handle = _get_item_handle(stack->get_item_id());
+		stack->set_item_handle(item_handle);
+	}
+	return item_handle;
+}
+
+bool Inventory::_stack_has_item(const Ref<ItemStack> &stack, const int item_handle, const String &item_id) const {
+	// Ids unknown to the database have no handle, compare them by name.
+	if (item_handle < 0)
+		return stack->get_item_id() == item_id;
+	return _get_stack_item_handle(stack) == item_handle;
+}
+
+Ref<ItemDefinition> Inventory::_get_stack_definition(const Ref<ItemStack> &stack) const {
+	ERR_FAIL_NULL_V_MSG(get_database(), nullptr, "The 'database' is null.");
+	return get_database()->get_item_from_handle(_get_stack_item_handle(stack));
+}
+
+void Inventory::_invalidate_item_stacks_index() {
+	item_stacks_indexed_size = -1;
+}
+
+void Inventory::_rebuild_item_stacks_index() const {
+	item_stacks_index.clear();
+	category_stacks_index.clear();
+	indexed_amount = 0;
+	indexed_weight = 0;
+	indexed_stacks_with_room = 0;
+	item_stacks_indexed_size = stacks.size();
+	indexed_definition_revision = ItemDefinition::get_cache_revision();
+	indexed_category_revision = ItemCategory::get_index_revision();
+	stack_positions_dirty = false;
+	stack_item_handles.resize(stacks.size());
+	stack_amounts.resize(stacks.size());
+	for (int i = 0; i < stacks.size(); i++) {
+		Ref<ItemStack> stack = stacks[i];
+		_cache_stack(i, stack);
+		if (stack == nullptr || stack->get_item_id().is_empty())
+			continue;
+		const int item_handle = stack_item_handles[i];
+		ItemStacks &item_stacks = _get_or_add_item_stacks(item_handle);
+		if (item_handle >= 0)
+			item_stacks.stack_indices.push_back(i);
+		item_stacks.stack_count++;
+		item_stacks.amount += stack->get_amount();
+		_account_indexed_stack(item_stacks, stack->get_amount(), 1);
+		_index_stack_categories(item_stacks, i, stack->get_amount());
+	}
+}
+
+void Inventory::_ensure_item_stacks_index() const {
+	// Stacks are edited in place from the inspector, so never trust the index there.
+	if (!_is_item_stacks_index_live() || item_stacks_indexed_size != stacks.size() || Engine::get_singleton()->is_editor_hint())
+		_rebuild_item_stacks_index();
+}
+
+bool Inventory::_is_item_stacks_index_live() const {
+	// Mutators leave a stale index alone, the next query rebuilds it.
+	return item_stacks_indexed_size >= 0 && indexed_definition_revision == ItemDefinition::get_cache_revision() && indexed_category_revision == ItemCategory::get_index_revision();
+}
+
+bool Inventory::_is_item_stacks_index_in_step() const {
+	// Stacks added or removed without the hooks below leave the cache short, it
+	// must not be written until the next query rebuilds it.
+	return _is_item_stacks_index_live() && item_stacks_indexed_size == stacks.size();
+}
+
+void Inventory::_ensure_stack_positions() const {
+	_ensure_item_stacks_index();
+	if (!stack_positions_dirty)
+		return;
+	for (KeyValue<int, ItemStacks> &E : item_stacks_index) {
+		E.value.stack_indices.clear();
+	}
+	for (uint32_t c = 0; c < category_stacks_index.size(); c++) {
+		category_stacks_index[c].stack_indices.clear();
+	}
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		if (stack_item_handles[i] < 0)
+			continue;
+		ItemStacks *item_stacks = item_stacks_index.getptr(stack_item_handles[i]);
+		if (item_stacks == nullptr)
+			continue;
+		item_stacks->stack_indices.push_back(i);
+		for (uint32_t c = 0; c < item_stacks->category_indices.size(); c++) {
+			category_stacks_index[item_stacks->category_indices[c]].stack_indices.push_back(i);
+		}
+	}
+	stack_positions_dirty = false;
+}
+
+const Inventory::ItemStacks *Inventory::_get_item_stacks(const int item_handle) const {
+	_ensure_item_stacks_index();
+	return item_stacks_index.getptr(item_handle);
+}
+
+Inventory::ItemStacks &Inventory::_get_or_add_item_stacks(const int item_handle) const {
+	ItemStacks *item_stacks = item_stacks_index.getptr(item_handle);
+	if (item_stacks != nullptr)
+		return *item_stacks;
+	ItemStacks new_item_stacks;
+	Ref<ItemDefinition> definition = get_database().is_valid() ? get_database()->get_item_from_handle(item_handle) : nullptr;
+	if (definition != nullptr) {
+		new_item_stacks.weight = definition->get_weight();
+		new_item_stacks.max_stack = definition->get_max_stack();
+		TypedArray<ItemCategory> categories = definition->get_categories();
+		for (int i = 0; i < categories.size(); i++) {
+			Ref<ItemCategory> category = categories[i];
+			if (category != nullptr && category->get_index() >= 0)
+				new_item_stacks.category_indices.push_back(category->get_index());
+		}
+	}
+	return item_stacks_index.insert(item_handle, new_item_stacks)->value;
+}
+
+int Inventory::_get_item_amount(const int item_handle, const String &item_id, bool &r_found) const {
+	const ItemStacks *item_stacks = _get_item_stacks(item_handle);
+	r_found = false;
+	int amount_in_inventory = 0;
+	if (item_handle >= 0) {
+		if (item_stacks != nullptr) {
+			r_found = true;
+			amount_in_inventory = item_stacks->amount;
+		}
+		if (!item_stacks_index.has(-1))
+			return amount_in_inventory;
+	}
+	// Stacks indexed without a handle are matched by id, and an id the database does
+	// not know is looked for in every stack, like before the index.
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		if (item_handle >= 0 && stack_item_handles[i] >= 0)
+			continue;
+		Ref<ItemStack> stack = stacks[i];
+		if (stack != nullptr && stack->get_item_id() == item_id) {
+			r_found = true;
+			amount_in_inventory += stack->get_amount();
+		}
+	}
+	return amount_in_inventory;
+}
+
+void Inventory::_get_stack_indices_of_item(const int item_handle, const String &item_id, LocalVector<int> &r_stack_indices) const {
+	r_stack_indices.clear();
+	_ensure_stack_positions();
+	if (item_handle >= 0 && !item_stacks_index.has(-1)) {
+		const ItemStacks *item_stacks = item_stacks_index.getptr(item_handle);
+		if (item_stacks != nullptr)
+			r_stack_indices = item_stacks->stack_indices;
+		return;
+	}
+	for (uint32_t i = 0; i < stack_item_handles.size(); i++) {
+		const int stack_item_handle = stack_item_handles[i];
+		if (item_handle >= 0 && stack_item_handle == item_handle) {
+			r_stack_indices.push_back(i);
+			continue;
+		}
+		if (item_handle >= 0 && stack_item_handle >= 0)
+			continue;
+		Ref<ItemStack> stack = stacks[i];
+		if (stack != nullptr && stack->get_item_id() == item_id)
+			r_stack_indices.push_back(i);
+	}
+}
+
+void Inventory::_account_indexed_stack(const ItemStacks &item_stacks, const int amount, const int sign) const {
+	indexed_amount += sign * amount;
+	indexed_weight += sign * item_stacks.weight * amount;
+	if (item_stacks.max_stack >= 0 && amount < item_stacks.max_stack)
+		indexed_stacks_with_room += sign;
+	// Keeps float error from piling up over a long session.
+	if (indexed_amount == 0)
+		indexed_weight = 0;
+}
+
+void Inventory::_index_stack_categories(const ItemStacks &item_stacks, const int stack_index, const int amount) const {
+	for (uint32_t i = 0; i < item_stacks.category_indices.size(); i++) {
+		uint32_t category_index = item_stacks.category_indices[i];
+		if (category_index >= category_stacks_index.size())
+			category_stacks_index.resize(category_index + 1);
+		CategoryStacks &category_stacks = category_stacks_index[category_index];
+		if (!stack_positions_dirty) {
+			uint32_t position = category_stacks.stack_indices.size();
+			while (position > 0 && category_stacks.stack_indices[position - 1] > stack_index)
+				position--;
+			category_stacks.stack_indices.insert(position, stack_index);
+		}
+		category_stacks.stack_count++;
+		category_stacks.amount += amount;
+	}
+}
+
+void Inventory::_unindex_stack_categories(const ItemStacks &item_stacks, const int stack_index, const int amount) {
+	for (uint32_t i = 0; i < item_stacks.category_indices.size(); i++) {
+		CategoryStacks &category_stacks = category_stacks_index[item_stacks.category_indices[i]];
+		if (!stack_positions_dirty)
+			category_stacks.stack_indices.erase(stack_index);
+		category_stacks.stack_count--;
+		category_stacks.amount -= amount;
+	}
+}
+
+const Inventory::CategoryStacks *Inventory::_get_category_stacks(const Ref<ItemCategory> &category) const {
+	_ensure_item_stacks_index();
+	int category_index = category->get_index();
+	if (category_index < 0 || category_index >= (int)category_stacks_index.size())
+		return nullptr;
+	return &category_stacks_index[category_index];
+}
+
+void Inventory::_index_stack(const int stack_index, const int item_handle, const int amount) {
+	if (!_is_item_stacks_index_in_step())
+		return;
+	ItemStacks &item_stacks = _get_or_add_item_stacks(item_handle);
+	if (item_handle >= 0 && !stack_positions_dirty) {
+		uint32_t position = item_stacks.stack_indices.size();
+		while (position > 0 && item_stacks.stack_indices[position - 1] > stack_index)
+			position--;
+		item_stacks.stack_indices.insert(position, stack_index);
+	}
+	item_stacks.stack_count++;
+	item_stacks.amount += amount;
+	_account_indexed_stack(item_stacks, amount, 1);
+	_index_stack_categories(item_stacks, stack_index, amount);
+}
+
+void Inventory::_unindex_stack(const int stack_index, const int item_handle, const int amount) {
+	if (!_is_item_stacks_index_live())
+		return;
+	ItemStacks *item_stacks = item_stacks_index.getptr(item_handle);
+	if (item_stacks == nullptr) {
+		_invalidate_item_stacks_index();
+		return;
+	}
+	if (item_handle >= 0 && !stack_positions_dirty)
+		item_stacks->stack_indices.erase(stack_index);
+	item_stacks->stack_count--;
+	item_stacks->amount -= amount;
+	_account_indexed_stack(*item_stacks, amount, -1);
+	_unindex_stack_categories(*item_stacks, stack_index, amount);
+	if (item_stacks->stack_count <= 0)
+		item_stacks_index.erase(item_handle);
+}
+
+void Inventory::_reindex_stack(const int stack_index, const String &old_item_id, const int old_amount) {
+	if (!_is_item_stacks_index_in_step())
+		return;
+	Ref<ItemStack> stack = stacks[stack_index];
+	// The cache still holds the handle the stack was indexed with.
+	const int old_item_handle = stack_item_handles[stack_index];
+	_cache_stack(stack_index, stack);
+	const int item_handle = stack_item_handles[stack_index];
+	const bool was_indexed = !old_item_id.is_empty();
+	const bool is_indexed = !stack->get_item_id().is_empty();
+	if (item_handle != old_item_handle || was_indexed != is_indexed) {
+		if (was_indexed)
+			_unindex_stack(stack_index, old_item_handle, old_amount);
+		if (is_indexed)
+			_index_stack(stack_index, item_handle, stack->get_amount());
+		return;
+	}
+	if (!was_indexed)
+		return;
+	ItemStacks *item_stacks = item_stacks_index.getptr(item_handle);
+	if (item_stacks == nullptr) {
+		_invalidate_item_stacks_index();
+		return;
+	}
+	item_stacks->amount += stack->get_amount() - old_amount;
+	_account_indexed_stack(*item_stacks, old_amount, -1);
+	_account_indexed_stack(*item_stacks, stack->get_amount(), 1);
+	for (uint32_t i = 0; i < item_stacks->category_indices.size(); i++) {
+		category_stacks_index[item_stacks->category_indices[i]].amount += stack->get_amount() - old_amount;
+	}
+}
+
+void Inventory::_on_indexed_stack_inserted(const int stack_index) {
+	if (!_is_item_stacks_index_live())
+		return;
+	if (item_stacks_indexed_size != stacks.size() - 1) {
+		_invalidate_item_stacks_index();
+		return;
+	}
+	// A stack appended at the end moves no other stack.
+	if (stack_index < item_stacks_indexed_size)
+		stack_positions_dirty = true;
+	stack_item_handles.insert(stack_index, -1);
+	stack_amounts.insert(stack_index, 0);
+	item_stacks_indexed_size++;
+}
+
+void Inventory::_on_indexed_stack_removed(const int stack_index) {
+	if (!_is_item_stacks_index_live())
+		return;
+	if (item_stacks_indexed_size != stacks.size() + 1) {
+		_invalidate_item_stacks_index();
+		return;
+	}
+	if (stack_index < item_stacks_indexed_size - 1)
+		stack_positions_dirty = true;
+	stack_item_handles.remove_at(stack_index);
+	stack_amounts.remove_at(stack_index);
+	item_stacks_indexed_size--;
+}
+
+void Inventory::_cache_stack(const int stack_index, const Ref<ItemStack> &stack) const {
+	if (!_is_item_stacks_index_in_step())
+		return;
+	stack_item_handles[stack_index] = stack == nullptr ? -1 : _get_stack_item_handle(stack);
+	stack_amounts[stack_index] = stack == nullptr ? 0 : stack->get_amount();
+}
+
+bool Inventory::_can_skip_stack_for_item(const int stack_index, const int item_handle) const {
+	// A stack is skipped only when it surely holds another known item.
+	if (item_stacks_indexed_size != stacks.size())
+		return false;
+	const int stack_item_handle = stack_item_handles[stack_index];
+	return stack_amounts[stack_index] > 0 && stack_item_handle >= 0 && stack_item_handle != item_handle;
+}
+
+void Inventory::_watch_stack(const Ref<ItemStack> &stack) {
+	if (stack == nullptr)
+		return;
+	Callable on_stack_edited = callable_mp(this, &Inventory::_on_stack_edited);
+	if (!stack->is_connected("changed", on_stack_edited))
+		stack->connect("changed", on_stack_edited);
+}
+
+void Inventory::_unwatch_stack(const Ref<ItemStack> &stack) {
+	if (stack == nullptr)
+		return;
+	Callable on_stack_edited = callable_mp(this, &Inventory::_on_stack_edited);
+	if (stack->is_connected("changed", on_stack_edited))
+		stack->disconnect("changed", on_stack_edited);
+}
+
+void Inventory::_watch_stacks() {
+	for (int i = 0; i < stacks.size(); i++) {
+		_watch_stack(stacks[i]);
+	}
+}
+
+void Inventory::_unwatch_stacks() {
+	for (int i = 0; i < stacks.size(); i++) {
+		_unwatch_stack(stacks[i]);
+	}
+}
+
+void Inventory::_on_stack_edited() {
+	// Only this inventory's index is stale, the stack does not say where it changed.
+	stacks_edit_revision++;
+	_invalidate_item_stacks_index();
+}
+
 bool Inventory::_can_add_on_inventory_from_constraints(const String item_id, const int amount, const Dictionary properties) const {
 	for (size_t i = 0; i < constraints.size(); i++) {
 		Ref<InventoryConstraint> constraint = constraints[i];
@@ -737,6 +1280,8 @@ void Inventory::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("remove", "item_id", "amount"), &Inventory::remove, DEFVAL(1));
 	ClassDB::bind_method(D_METHOD("remove_at", "stack_index", "item_id", "amount"), &Inventory::remove_at, DEFVAL(1));
 	ClassDB::bind_method(D_METHOD("remove_stack", "stack_index"), &Inventory::remove_stack);
+	ClassDB::bind_method(D_METHOD("add_many", "item_ids", "amounts", "properties"), &Inventory::add_many, DEFVAL(Array()));
+	ClassDB::bind_method(D_METHOD("remove_many", "item_ids", "amounts"), &Inventory::remove_many);
 	ClassDB::bind_method(D_METHOD("split", "stack_index", "amount"), &Inventory::split, DEFVAL(1));
 	ClassDB::bind_method(D_METHOD("transfer_at", "stack_index", "destination", "destination_stack_index", "amount"), &Inventory::transfer_at, DEFVAL(1));
 	ClassDB::bind_method(D_METHOD("transfer", "stack_index", "destination", "amount"), &Inventory::transfer, DEFVAL(1));
@@ -758,6 +1303,9 @@ void Inventory::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_constraints", "constraints"), &Inventory::set_constraints);
 	ClassDB::bind_method(D_METHOD("get_constraints"), &Inventory::get_constraints);
 	ClassDB::bind_method(D_METHOD("update_stack", "stack_index"), &Inventory::update_stack);
+	ClassDB::bind_method(D_METHOD("begin_batch"), &Inventory::begin_batch);
+	ClassDB::bind_method(D_METHOD("commit_batch"), &Inventory::commit_batch);
+	ClassDB::bind_method(D_METHOD("is_batching"), &Inventory::is_batching);
 	ADD_SIGNAL(MethodInfo("contents_changed"));
 	ADD_SIGNAL(MethodInfo("stack_added", PropertyInfo(Variant::INT, "stack_index")));
 	ADD_SIGNAL(MethodInfo("stack_removed", PropertyInfo(Variant::INT, "stack_index")));
@@ -766,6 +1314,7 @@ void Inventory::_bind_methods() {
 	ADD_SIGNAL(MethodInfo("filled"));
 	ADD_SIGNAL(MethodInfo("emptied"));
 	ADD_SIGNAL(MethodInfo("updated_stack", PropertyInfo(Variant::INT, "stack_index")));
+	ADD_SIGNAL(MethodInfo("batch_committed", PropertyInfo(Variant::PACKED_INT32_ARRAY, "changed_stacks"), PropertyInfo(Variant::PACKED_STRING_ARRAY, "item_ids"), PropertyInfo(Variant::PACKED_INT32_ARRAY, "item_deltas"), PropertyInfo(Variant::PACKED_INT32_ARRAY, "added_stacks"), PropertyInfo(Variant::PACKED_INT32_ARRAY, "removed_stacks")));
 
 	ADD_SIGNAL(MethodInfo("request_drop_item", PropertyInfo(Variant::STRING, "item_id"), PropertyInfo(Variant::INT, "amount"), PropertyInfo(Variant::DICTIONARY, "item_properties")));
 
@@ -775,10 +1324,132 @@ void Inventory::_bind_methods() {
 }
 
 void Inventory::update_stack(const int stack_index) {
+	stacks_edit_revision++;
+	_invalidate_item_stacks_index();
+	if (is_batching()) {
+		ERR_FAIL_COND_MSG(stack_index < 0 || stack_index >= stacks.size(), "The 'stack index' is out of bounds.");
+		Ref<ItemStack> stack = stacks[stack_index];
+		_record_batch_change(stack, "", 0, "", 0);
+		return;
+	}
 	emit_signal("updated_stack", stack_index);
 	_call_events(amount());
 }
 
+uint64_t Inventory::get_stacks_edit_revision() const {
+	return stacks_edit_revision;
+}
+
+void Inventory::begin_batch() {
+	if (batch.depth == 0) {
+		batch.old_amount = amount();
+		batch.initial_indices.reserve(stacks.size());
+		for (int i = 0; i < stacks.size(); i++) {
+			Ref<ItemStack> stack = stacks[i];
+			if (stack != nullptr)
+				batch.initial_indices.insert(stack.ptr(), i);
+		}
+	}
+	batch.depth++;
+}
+
+void Inventory::commit_batch() {
+	ERR_FAIL_COND_MSG(batch.depth == 0, "'commit_batch' called without a matching 'begin_batch'.");
+	batch.depth--;
+	if (batch.depth > 0)
+		return;
+
+	HashMap<ItemStack *, int> current_indices;
+	current_indices.reserve(stacks.size());
+	for (int i = 0; i < stacks.size(); i++) {
+		Ref<ItemStack> stack = stacks[i];
+		if (stack != nullptr)
+			current_indices.insert(stack.ptr(), i);
+	}
+
+	// Changed and added stacks use the indices after the batch,
+	// removed stacks the indices they had before it.
+	PackedInt32Array changed_stacks;
+	PackedInt32Array added_stacks;
+	PackedInt32Array removed_stacks;
+	for (uint32_t i = 0; i < batch.touched_stacks.size(); i++) {
+		Ref<ItemStack> stack = batch.touched_stacks[i];
+		const int *current_index = current_indices.getptr(stack.ptr());
+		const int *initial_index = batch.initial_indices.getptr(stack.ptr());
+		if (current_index != nullptr) {
+			stack->emit_signal("updated");
+			if (initial_index != nullptr) {
+				changed_stacks.append(*current_index);
+			} else {
+				added_stacks.append(*current_index);
+			}
+		} else if (initial_index != nullptr) {
+			removed_stacks.append(*initial_index);
+		}
+	}
+	changed_stacks.sort();
+	added_stacks.sort();
+	removed_stacks.sort();
+
+	PackedStringArray item_ids;
+	PackedInt32Array item_deltas;
+	for (const KeyValue<String, int> &E : batch.item_deltas) {
+		if (E.value == 0)
+			continue;
+		item_ids.append(E.key);
+		item_deltas.append(E.value);
+	}
+
+	int old_amount = batch.old_amount;
+	batch.initial_indices.clear();
+	batch.touched_stacks.clear();
+	batch.touched.clear();
+	batch.item_deltas.clear();
+
+	if (!changed_stacks.is_empty() || !added_stacks.is_empty() || !removed_stacks.is_empty() || !item_ids.is_empty()) {
+		_flag_contents_changed = true;
+		emit_signal("batch_committed", changed_stacks, item_ids, item_deltas, added_stacks, removed_stacks);
+	}
+	_call_events(old_amount);
+}
+
+bool Inventory::is_batching() const {
+	return batch.depth > 0;
+}
+
+void Inventory::_record_batch_change(const Ref<ItemStack> &stack, const String &old_item_id, const int old_amount, const String &new_item_id, const int new_amount) {
+	if (!is_batching() || stack == nullptr)
+		return;
+	if (!batch.touched.has(stack.ptr())) {
+		batch.touched.insert(stack.ptr());
+		batch.touched_stacks.push_back(stack);
+	}
+	if (!old_item_id.is_empty() && old_amount != 0) {
+		int *delta = batch.item_deltas.getptr(old_item_id);
+		if (delta == nullptr)
+			delta = &batch.item_deltas.insert(old_item_id, 0)->value;
+		*delta -= old_amount;
+	}
+	if (!new_item_id.is_empty() && new_amount != 0) {
+		int *delta = batch.item_deltas.getptr(new_item_id);
+		if (delta == nullptr)
+			delta = &batch.item_deltas.insert(new_item_id, 0)->value;
+		*delta += new_amount;
+	}
+}
+
+void Inventory::_replace_stack_content(const int stack_index, const String &item_id, const int amount, const Dictionary &properties) {
+	ERR_FAIL_COND_MSG(stack_index < 0 || stack_index >= stacks.size(), "The 'stack_index' is out of bounds.");
+	Ref<ItemStack> stack = stacks[stack_index];
+	String old_item_id = stack->get_item_id();
+	int old_amount = stack->get_amount();
+	stack->set_content(item_id, _get_item_handle(item_id), amount, properties, false);
+	_reindex_stack(stack_index, old_item_id, old_amount);
+	_record_batch_change(stack, old_item_id, old_amount, item_id, amount);
+	if (!is_batching())
+		_flag_contents_changed = true;
+}
+
 void Inventory::_process(float delta) {
 	if (Engine::get_singleton()->is_editor_hint())
 		return;
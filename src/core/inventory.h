@@ -4,6 +4,9 @@
 #include "base/item_stack.h"
 #include "base/node_inventories.h"
 #include "constraints/inventory_constraint.h"
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/hash_set.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
 using namespace godot;
 
@@ -14,17 +17,112 @@ private:
 	int max_size = 16;
 	String inventory_name = "Inventory";
 	TypedArray<InventoryConstraint> constraints;
+
+	// Index from item handle to the stacks holding it (in stack order) and their total amount.
+	// Ids unknown to the database share the -1 entry, which only counts toward the totals,
+	// queries on those ids scan the stacks.
+	// Kept in step by the internal mutators, rebuilt lazily when stacks are replaced or
+	// edited from outside (see update_stack and _on_stack_edited).
+	// Stack indices only follow stacks added or removed at the end, any other insertion
+	// or removal marks them stale and they are recomputed from the stack cache when a query needs them.
+	// Weight, max stack and categories are taken from the definition when the item is first
+	// indexed, and the whole index is rebuilt when a definition changes them
+	// (see ItemDefinition::get_cache_revision).
+	struct ItemStacks {
+		LocalVector<int> stack_indices;
+		int stack_count = 0;
+		int amount = 0;
+		float weight = 0;
+		int max_stack = -1;
+		LocalVector<int> category_indices;
+	};
+	mutable HashMap<int, ItemStacks> item_stacks_index;
+	// Same totals per category, by category index (see ItemCategory::get_index), rebuilt
+	// when indices are renumbered. Stack indices go stale with the item ones.
+	struct CategoryStacks {
+		LocalVector<int> stack_indices;
+		int stack_count = 0;
+		int amount = 0;
+	};
+	mutable LocalVector<CategoryStacks> category_stacks_index;
+	mutable int64_t item_stacks_indexed_size = -1;
+	// Bumped when the contents change without item_added or item_removed naming the
+	// items: a stack emits 'changed' (only the setters scripts and the inspector use do,
+	// the internal mutators go through ItemStack::set_content), or the stacks are
+	// replaced, set or removed whole.
+	uint64_t stacks_edit_revision = 0;
+	mutable uint64_t indexed_definition_revision = 0;
+	mutable uint64_t indexed_category_revision = 0;
+	mutable bool stack_positions_dirty = false;
+	// Running totals over the indexed stacks.
+	mutable int indexed_amount = 0;
+	mutable float indexed_weight = 0;
+	mutable int indexed_stacks_with_room = 0;
+	// Write-through cache of the handle and amount of each stack, in stack order, so
+	// scans can skip the ItemStack resources, which stay the storage.
+	// Handle is -1 for free stacks and ids unknown to the database.
+	mutable LocalVector<int> stack_item_handles;
+	mutable LocalVector<int> stack_amounts;
+	void _rebuild_item_stacks_index() const;
+	void _ensure_item_stacks_index() const;
+	bool _is_item_stacks_index_live() const;
+	bool _is_item_stacks_index_in_step() const;
+	void _ensure_stack_positions() const;
+	const ItemStacks *_get_item_stacks(const int item_handle) const;
+	ItemStacks &_get_or_add_item_stacks(const int item_handle) const;
+	void _get_stack_indices_of_item(const int item_handle, const String &item_id, LocalVector<int> &r_stack_indices) const;
+	int _get_item_amount(const int item_handle, const String &item_id, bool &r_found) const;
+	void _account_indexed_stack(const ItemStacks &item_stacks, const int amount, const int sign) const;
+	void _index_stack_categories(const ItemStacks &item_stacks, const int stack_index, const int amount) const;
+	void _unindex_stack_categories(const ItemStacks &item_stacks, const int stack_index, const int amount);
+	const CategoryStacks *_get_category_stacks(const Ref<ItemCategory> &category) const;
+	void _index_stack(const int stack_index, const int item_handle, const int amount);
+	void _unindex_stack(const int stack_index, const int item_handle, const int amount);
+	void _reindex_stack(const int stack_index, const String &old_item_id, const int old_amount);
+	void _on_indexed_stack_inserted(const int stack_index);
+	void _on_indexed_stack_removed(const int stack_index);
+	void _cache_stack(const int stack_index, const Ref<ItemStack> &stack) const;
+	bool _can_skip_stack_for_item(const int stack_index, const int item_handle) const;
+	void _watch_stack(const Ref<ItemStack> &stack);
+	void _unwatch_stack(const Ref<ItemStack> &stack);
+	void _watch_stacks();
+	void _unwatch_stacks();
+	void _on_stack_edited();
+
+	// Pending change set between begin_batch and commit_batch. Stacks are kept
+	// referenced so their pointers stay unique until the batch is committed.
+	struct Batch {
+		int depth = 0;
+		int old_amount = 0;
+		HashMap<ItemStack *, int> initial_indices;
+		LocalVector<Ref<ItemStack>> touched_stacks;
+		HashSet<ItemStack *> touched;
+		HashMap<String, int> item_deltas;
+	};
+	Batch batch;
+
 	void _insert_stack(int stack_index);
 	void _remove_stack_at(int stack_index);
 	void _call_events(int old_amount);
-	int _add_to_stack(int stack_index, const String &item_id, int amount = 1, const Dictionary &properties = Dictionary(), const bool can_emit_item_added_signal = true);
-	int _remove_from_stack(int stack_index, const String &item_id, int amount = 1);
+	int _remove_from_stack(int stack_index, const String &item_id, const int item_handle, int amount = 1);
+	int _add_to_item_stack(Ref<ItemStack> stack, const String &item_id, const int item_handle, const int amount, const Dictionary &properties, const bool can_emit_item_added_signal);
+	int _remove_from_item_stack(Ref<ItemStack> stack, const String &item_id, const int item_handle, const int amount);
 
 protected:
 	bool _flag_contents_changed = false;
 	TypedArray<ItemStack> stacks;
+	virtual void _invalidate_item_stacks_index();
+	int _add_to_stack(int stack_index, const String &item_id, const int item_handle, int amount = 1, const Dictionary &properties = Dictionary(), const bool can_emit_item_added_signal = true);
+	void _record_batch_change(const Ref<ItemStack> &stack, const String &old_item_id, const int old_amount, const String &new_item_id, const int new_amount);
+	// Swaps in new content keeping the index and the batch in step, emits nothing.
+	void _replace_stack_content(const int stack_index, const String &item_id, const int amount, const Dictionary &properties);
 	static void _bind_methods();
 	int _get_max_stack_for_stack(const String item_id, const int amount, const Dictionary properties) const;
+	int _get_max_stack_for_stack(const int item_handle, const String item_id, const int amount, const Dictionary properties) const;
+	int _get_item_handle(const String &item_id) const;
+	int _get_stack_item_handle(const Ref<ItemStack> &stack) const;
+	bool _stack_has_item(const Ref<ItemStack> &stack, const int item_handle, const String &item_id) const;
+	Ref<ItemDefinition> _get_stack_definition(const Ref<ItemStack> &stack) const;
 	bool _can_add_on_inventory_from_constraints(const String item_id, const int amount, const Dictionary properties) const;
 	bool _can_add_new_stack_on_inventory_from_constraints(const String item_id, const int amount, const Dictionary properties) const;
 	int _get_max_stack_from_constraints(const String item_id, const int amount, const Dictionary properties, const int max_stack) const;
@@ -38,6 +136,10 @@ public:
 	virtual void _process(float delta);
 	void set_stack_content(const int stack_index, const String &item_id, const int &amount, const Dictionary &properties);
 	void update_stack(const int stack_index);
+	uint64_t get_stacks_edit_revision() const;
+	void begin_batch();
+	void commit_batch();
+	bool is_batching() const;
 	bool is_empty() const;
 	virtual bool is_full() const;
 	void clear();
@@ -58,6 +160,8 @@ public:
 	void remove_stack(const int &stack_index);
 	int remove(const String &item_id, const int &amount = 1);
 	int remove_at(const int &stack_index, const String &item_id, const int &amount = 1);
+	PackedInt32Array add_many(const PackedStringArray &item_ids, const PackedInt32Array &amounts, const Array &properties = Array());
+	PackedInt32Array remove_many(const PackedStringArray &item_ids, const PackedInt32Array &amounts);
 	bool split(const int &stack_index, const int &amount = 1);
 	int transfer_at(const int &stack_index, Inventory *destination, const int &destination_stack_index, const int &amount = 1);
 	int transfer(const int &stack_index, Inventory *destination, const int &amount = 1);
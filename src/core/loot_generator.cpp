@@ -110,9 +110,7 @@ TypedArray<ItemStack> LootGenerator::generate_loot(int rolls) {
 
 		// Create an ItemStack and add it to the generated loot
 		Ref<ItemStack> item_stack = memnew(ItemStack);
-		item_stack->set_item_id(loot_item->get_item_id());
-		item_stack->set_amount(amount);
-		item_stack->set_properties(properties);
+		item_stack->set_content(loot_item->get_item_id(), -1, amount, properties, false);
 
 		generated_loot.append(item_stack);
 	}
@@ -128,12 +126,18 @@ void LootGenerator::add_loot_to_inventory(int rolls) {
 	}
 
 	TypedArray<ItemStack> loot = generate_loot(rolls);
+	PackedStringArray item_ids;
+	PackedInt32Array amounts;
+	Array properties;
 	for (int i = 0; i < loot.size(); i++) {
 		Ref<ItemStack> item_stack = loot[i];
 		if (item_stack.is_valid()) {
-			target_inventory->add(item_stack->get_item_id(), item_stack->get_amount(), item_stack->get_properties());
+			item_ids.append(item_stack->get_item_id());
+			amounts.append(item_stack->get_amount());
+			properties.append(item_stack->get_properties());
 		}
 	}
+	target_inventory->add_many(item_ids, amounts, properties);
 }
 
 void LootGenerator::apply_property_ranges(Dictionary &properties, const Dictionary &property_ranges, Ref<RandomNumberGenerator> &rng) const {
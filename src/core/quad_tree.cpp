@@ -66,252 +66,589 @@ void QuadTree::QuadNode::_bind_methods() {
 }
 
 QuadTree::QuadNode::QuadNode() {
-	quadrants.push_back(nullptr);
-	quadrants.push_back(nullptr);
-	quadrants.push_back(nullptr);
-	quadrants.push_back(nullptr);
 }
 
 QuadTree::QuadNode::~QuadNode() {
 }
 
+void QuadTree::QuadNode::_ensure_tree() {
+	if (tree.is_valid())
+		return;
+	tree.instantiate();
+	tree->size = pending_rect.size;
+	tree->root_index = tree->_alloc_node(pending_rect);
+	node_index = tree->root_index;
+}
+
+bool QuadTree::QuadNode::_has_node() const {
+	return tree.is_valid() && node_index >= 0 && node_index < (int)tree->nodes.size();
+}
+
 bool QuadTree::QuadNode::can_subdivide(const Vector2i &size) {
 	return size.x > 1 && size.y > 1;
 }
 
 TypedArray<Rect2i> QuadTree::QuadNode::get_quadrant_rects(const Rect2i &rect) {
 	TypedArray<Rect2i> result = TypedArray<Rect2i>();
-	int64_t q0w = UtilityFunctions::roundi(float(rect.size.x) / 2.0);
-	int64_t q0h = UtilityFunctions::roundi(float(rect.size.y) / 2.0);
-	Rect2i q0 = Rect2i(rect.position, Vector2i(q0w, q0h));
-	Rect2i q3 = Rect2i(rect.position + q0.size, rect.size - q0.size);
-	Rect2i q1 = Rect2i(Vector2i(q3.position.x, q0.position.y), Vector2i(q3.size.x, q0.size.y));
-	Rect2i q2 = Rect2i(Vector2i(q0.position.x, q3.position.y), Vector2i(q0.size.x, q3.size.y));
-	result.append(q0);
-	result.append(q1);
-	result.append(q2);
-	result.append(q3);
+	Rect2i quadrant_rects[4];
+	QuadTree::_get_quadrant_rects(rect, quadrant_rects);
+	for (int i = 0; i < 4; i++) {
+		result.append(quadrant_rects[i]);
+	}
 	return result;
 }
 
 void QuadTree::QuadNode::_init(const Rect2i &rect) {
-	this->rect = rect;
+	set_rect(rect);
+}
+
+void QuadTree::QuadNode::_set_view(const Ref<QuadTree> &tree, const int node_index) {
+	this->tree = tree;
+	this->node_index = node_index;
 }
 
 void QuadTree::QuadNode::set_quadrants(const TypedArray<QuadNode> &new_quadrants) {
-    quadrants = new_quadrants;
+	// Quadrants are owned by the tree, their contents are added back through this node.
+	_ensure_tree();
+	LocalVector<int> payload_ids;
+	for (int i = 0; i < new_quadrants.size(); i++) {
+		Ref<QuadNode> quadrant = new_quadrants[i];
+		if (quadrant == nullptr || !quadrant->_has_node() || quadrant->tree == tree)
+			continue;
+		payload_ids.clear();
+		quadrant->tree->_collect_payloads(quadrant->node_index, quadrant->tree->_begin_visit(), payload_ids);
+		for (uint32_t j = 0; j < payload_ids.size(); j++) {
+			int payload = payload_ids[j];
+			tree->_add_payload(quadrant->tree->get_payload_rect(payload), quadrant->tree->get_payload_metadata(payload), node_index);
+		}
+	}
 }
 
 TypedArray<QuadTree::QuadNode> QuadTree::QuadNode::get_quadrants() const {
-	return quadrants;
+	TypedArray<QuadNode> result = TypedArray<QuadNode>();
+	result.resize(4);
+	if (!_has_node())
+		return result;
+	for (int i = 0; i < 4; i++) {
+		int child = tree->nodes[node_index].children[i];
+		if (child == -1)
+			continue;
+		Ref<QuadNode> quadrant = memnew(QuadNode());
+		quadrant->_set_view(tree, child);
+		result[i] = quadrant;
+	}
+	return result;
 }
 
 void QuadTree::QuadNode::set_quadrant_count(const int &new_quadrant_count) {
-    quadrant_count = new_quadrant_count;
+	// Derived from the quadrants, kept for compatibility.
 }
 
 int QuadTree::QuadNode::get_quadrant_count() const {
-	return quadrant_count;
+	if (!_has_node())
+		return 0;
+	return tree->nodes[node_index].child_count;
 }
 
 void QuadTree::QuadNode::set_quad_rects(const TypedArray<QuadRect> &new_quad_rects) {
-    quad_rects = new_quad_rects;
+	_ensure_tree();
+	while (tree->nodes[node_index].first_entry != -1) {
+		int entry = tree->nodes[node_index].first_entry;
+		tree->nodes[node_index].first_entry = tree->entries[entry].next;
+		tree->_free_entry(entry);
+	}
+	for (int i = 0; i < new_quad_rects.size(); i++) {
+		Ref<QuadRect> quad_rect = new_quad_rects[i];
+		if (quad_rect == nullptr)
+			continue;
+		tree->_add_payload(quad_rect->get_rect(), quad_rect->get_metadata(), node_index);
+	}
 }
 
 TypedArray<QuadTree::QuadRect> QuadTree::QuadNode::get_quad_rects() const {
-	return quad_rects;
+	TypedArray<QuadRect> result = TypedArray<QuadRect>();
+	if (!_has_node())
+		return result;
+	for (int entry = tree->nodes[node_index].first_entry; entry != -1; entry = tree->entries[entry].next) {
+		result.append(tree->_make_quad_rect(tree->entries[entry].payload));
+	}
+	return result;
 }
 
 void QuadTree::QuadNode::set_rect(const Rect2i &new_rect) {
-    rect = new_rect;
+	pending_rect = new_rect;
+	if (_has_node()) {
+		tree->nodes[node_index].rect = new_rect;
+		return;
+	}
+	_ensure_tree();
 }
 
 Rect2i QuadTree::QuadNode::get_rect() const {
-	return rect;
+	if (!_has_node())
+		return pending_rect;
+	return tree->nodes[node_index].rect;
 }
 
 String QuadTree::QuadNode::to_string() const {
-	return "[R: " + UtilityFunctions::str(rect) + "]";
+	return "[R: " + UtilityFunctions::str(get_rect()) + "]";
 }
 
 bool QuadTree::QuadNode::is_empty() const {
-	return quadrant_count == 0 && quad_rects.is_empty();
+	if (!_has_node())
+		return true;
+	return tree->_is_node_empty(node_index);
 }
 
 Ref<QuadTree::QuadRect> QuadTree::QuadNode::get_first_under_rect(const Rect2i &test_rect, const Variant &exception_metadata) const {
-	for (size_t i = 0; i < quad_rects.size(); i++) {
-		Ref<QuadRect> quad_rect = quad_rects[i];
-		if (UtilityFunctions::type_of(exception_metadata) != GDEXTENSION_VARIANT_TYPE_NIL && quad_rect->get_metadata() == exception_metadata)
-			continue;
-		if (quad_rect->get_rect().intersects(test_rect))
-			return quad_rect;
+	if (!_has_node())
+		return nullptr;
+	return tree->_make_quad_rect(tree->_get_first_under_rect(node_index, test_rect, tree->_get_exception_key(exception_metadata)));
+}
+
+Ref<QuadTree::QuadRect> QuadTree::QuadNode::get_first_containing_point(const Vector2i &point, const Variant &exception_metadata) const {
+	if (!_has_node())
+		return nullptr;
+	return tree->_make_quad_rect(tree->_get_first_containing_point(node_index, point, tree->_get_exception_key(exception_metadata)));
+}
+
+Array QuadTree::QuadNode::get_all_under_rect(const Rect2i &test_rect, const Variant &exception_metadata) const {
+	if (!_has_node())
+		return Array();
+	LocalVector<int> &payload_ids = tree->query_payloads;
+	payload_ids.clear();
+	tree->_get_all_under_rect(node_index, test_rect, tree->_get_exception_key(exception_metadata), tree->_begin_visit(), payload_ids);
+	return tree->_make_quad_rects(payload_ids);
+}
+
+Array QuadTree::QuadNode::get_all_containing_point(const Vector2i &point, const Variant &exception_metadata) const {
+	if (!_has_node())
+		return Array();
+	LocalVector<int> &payload_ids = tree->query_payloads;
+	payload_ids.clear();
+	tree->_get_all_containing_point(node_index, point, tree->_get_exception_key(exception_metadata), tree->_begin_visit(), payload_ids);
+	return tree->_make_quad_rects(payload_ids);
+}
+
+void QuadTree::QuadNode::add(const Ref<QuadTree::QuadRect> &quad_rect) {
+	ERR_FAIL_NULL_MSG(quad_rect, "'quad_rect' is null.");
+	_ensure_tree();
+	tree->_add_payload(quad_rect->get_rect(), quad_rect->get_metadata(), node_index);
+}
+
+bool QuadTree::QuadNode::remove(const Variant &metadata) {
+	if (!_has_node())
+		return false;
+	if (node_index == tree->root_index)
+		return tree->remove(metadata);
+	int key = tree->find_key(metadata);
+	if (key == -1)
+		return false;
+	bool result = false;
+	for (int payload = tree->keys[key].first_payload; payload != -1; payload = tree->payloads[payload].next_in_key) {
+		if (tree->_remove_from_node(node_index, payload))
+			result = true;
 	}
-	for (size_t quadrant_index = 0; quadrant_index < quadrants.size(); quadrant_index++) {
-		Ref<QuadNode> quadrant = quadrants[quadrant_index];
-		if (quadrant == nullptr)
-			continue;
-		if (!quadrant->rect.intersects(test_rect))
-			continue;
-		Ref<QuadRect> first = quadrant->get_first_under_rect(test_rect, exception_metadata);
-		if (first != nullptr)
-			return first;
+	return result;
+}
+
+void QuadTree::QuadNode::_collapse() {
+	if (!_has_node())
+		return;
+	tree->_collapse_node(node_index);
+}
+
+void QuadTree::_get_quadrant_rects(const Rect2i &rect, Rect2i *r_quadrants) {
+	// The first quadrant takes the rounded up half on each axis.
+	Vector2i q0_size = Vector2i((rect.size.x + 1) / 2, (rect.size.y + 1) / 2);
+	Rect2i q0 = Rect2i(rect.position, q0_size);
+	Rect2i q3 = Rect2i(rect.position + q0.size, rect.size - q0.size);
+	r_quadrants[0] = q0;
+	r_quadrants[1] = Rect2i(Vector2i(q3.position.x, q0.position.y), Vector2i(q3.size.x, q0.size.y));
+	r_quadrants[2] = Rect2i(Vector2i(q0.position.x, q3.position.y), Vector2i(q0.size.x, q3.size.y));
+	r_quadrants[3] = q3;
+}
+
+int QuadTree::_alloc_node(const Rect2i &rect) {
+	int node_index;
+	if (free_node != -1) {
+		node_index = free_node;
+		free_node = nodes[node_index].next_free;
+		nodes[node_index] = NodeData();
+	} else {
+		node_index = nodes.size();
+		nodes.push_back(NodeData());
 	}
-	return nullptr;
+	nodes[node_index].rect = rect;
+	return node_index;
 }
 
-Ref<QuadTree::QuadRect> QuadTree::QuadNode::get_first_containing_point(const Vector2i &point, const Variant &exception_metadata) const {
-	for (size_t quad_rect_index = 0; quad_rect_index < quad_rects.size(); quad_rect_index++) {
-		Ref<QuadRect> quad_rect = quad_rects[quad_rect_index];
-		if (UtilityFunctions::type_of(exception_metadata) != GDEXTENSION_VARIANT_TYPE_NIL && quad_rect->get_metadata() == exception_metadata)
-			continue;
-		if (quad_rect->get_rect().has_point(point))
-			return quad_rect;
+void QuadTree::_free_node(const int node_index) {
+	while (nodes[node_index].first_entry != -1) {
+		int entry = nodes[node_index].first_entry;
+		nodes[node_index].first_entry = entries[entry].next;
+		_free_entry(entry);
+	}
+	for (int i = 0; i < 4; i++) {
+		int child = nodes[node_index].children[i];
+		if (child != -1)
+			_free_node(child);
+		nodes[node_index].children[i] = -1;
+	}
+	nodes[node_index].child_count = 0;
+	nodes[node_index].next_free = free_node;
+	free_node = node_index;
+}
+
+int QuadTree::_alloc_entry(const int payload, const int next) {
+	int entry;
+	if (free_entry != -1) {
+		entry = free_entry;
+		free_entry = entries[entry].next;
+	} else {
+		entry = entries.size();
+		entries.push_back(EntryData());
+	}
+	entries[entry].payload = payload;
+	entries[entry].next = next;
+	return entry;
+}
+
+void QuadTree::_free_entry(const int entry) {
+	entries[entry].payload = -1;
+	entries[entry].next = free_entry;
+	free_entry = entry;
+}
+
+int QuadTree::_register_payload(const Rect2i &rect, const Variant &metadata) {
+	int key;
+	const int *existing_key = key_indices.getptr(metadata);
+	if (existing_key != nullptr) {
+		key = *existing_key;
+	} else {
+		if (free_key != -1) {
+			key = free_key;
+			free_key = keys[key].next_free;
+		} else {
+			key = keys.size();
+			keys.push_back(KeyData());
+		}
+		keys[key].metadata = metadata;
+		keys[key].first_payload = -1;
+		keys[key].next_free = -1;
+		key_indices.insert(metadata, key);
 	}
 
-	for (size_t quadrant_index = 0; quadrant_index < quadrants.size(); quadrant_index++) {
-		Ref<QuadNode> quadrant = quadrants[quadrant_index];
-		if (quadrant == nullptr)
-			continue;
-		if (!quadrant->rect.has_point(point))
-			continue;
-		Ref<QuadRect> first = quadrant->get_first_containing_point(point, exception_metadata);
-		if (first != nullptr)
-			return first;
+	int payload;
+	if (free_payload != -1) {
+		payload = free_payload;
+		free_payload = payloads[payload].next_in_key;
+	} else {
+		payload = payloads.size();
+		payloads.push_back(PayloadData());
+	}
+	payloads[payload].rect = rect;
+	payloads[payload].key = key;
+	payloads[payload].next_in_key = keys[key].first_payload;
+	keys[key].first_payload = payload;
+	return payload;
+}
+
+int QuadTree::_add_payload(const Rect2i &rect, const Variant &metadata, const int node_index) {
+	ERR_FAIL_COND_V_MSG(node_index < 0 || node_index >= (int)nodes.size(), -1, "'root node' is null.");
+	int payload = _register_payload(rect, metadata);
+	_add_to_node(node_index, payload);
+	return payload;
+}
+
+void QuadTree::_build_node(const int node_index, LocalVector<int> &r_scratch, const uint32_t begin, const uint32_t end) {
+	// Same shape _add_to_node ends up with: a node only keeps rects when it holds a
+	// single one or can't be split, otherwise they go to the quadrants they overlap.
+	// The payloads of each quadrant are appended past end and dropped on return.
+	uint32_t count = end - begin;
+	if (count == 0)
+		return;
+	if (count == 1 || !QuadNode::can_subdivide(nodes[node_index].rect.size)) {
+		for (uint32_t i = begin; i < end; i++) {
+			nodes[node_index].first_entry = _alloc_entry(r_scratch[i], nodes[node_index].first_entry);
+		}
+		return;
 	}
 
-	return nullptr;
+	Rect2i quadrant_rects[4];
+	_get_quadrant_rects(nodes[node_index].rect, quadrant_rects);
+	for (int i = 0; i < 4; i++) {
+		uint32_t quadrant_begin = r_scratch.size();
+		for (uint32_t j = begin; j < end; j++) {
+			int payload = r_scratch[j];
+			if (quadrant_rects[i].intersects(payloads[payload].rect))
+				r_scratch.push_back(payload);
+		}
+		uint32_t quadrant_end = r_scratch.size();
+		if (quadrant_end != quadrant_begin) {
+			int quadrant = _alloc_node(quadrant_rects[i]);
+			nodes[node_index].children[i] = quadrant;
+			nodes[node_index].child_count += 1;
+			_build_node(quadrant, r_scratch, quadrant_begin, quadrant_end);
+		}
+		r_scratch.resize(quadrant_begin);
+	}
+	_collapse_node(node_index);
 }
 
-Array QuadTree::QuadNode::get_all_under_rect(const Rect2i &test_rect, const Variant &exception_metadata) const {
-	Array result = Array();
-	for (size_t quad_rect_index = 0; quad_rect_index < quad_rects.size(); quad_rect_index++) {
-		Ref<QuadRect> quad_rect = quad_rects[quad_rect_index];
-		if (UtilityFunctions::type_of(exception_metadata) != GDEXTENSION_VARIANT_TYPE_NIL && quad_rect->get_metadata() == exception_metadata)
-			continue;
-		if (quad_rect->get_rect().intersects(test_rect))
-			result.append(quad_rect);
-	}
-	for (size_t quadrant_index = 0; quadrant_index < quadrants.size(); quadrant_index++) {
-		Ref<QuadNode> quadrant = quadrants[quadrant_index];
-		if (quadrant == nullptr)
-			continue;
-		if (!quadrant->rect.intersects(test_rect))
-			continue;
-		result.append_array(quadrant->get_all_under_rect(test_rect, exception_metadata));
+int QuadTree::_get_exception_key(const Variant &exception_metadata) const {
+	if (exception_metadata.get_type() == Variant::NIL)
+		return -1;
+	return find_key(exception_metadata);
+}
+
+uint32_t QuadTree::_begin_visit() const {
+	visit_stamp++;
+	if (visit_stamp == 0) {
+		// Wrapped around, old stamps could match again.
+		for (uint32_t i = 0; i < payloads.size(); i++) {
+			payloads[i].visit = 0;
+		}
+		visit_stamp = 1;
 	}
-	return result;
+	return visit_stamp;
 }
 
-Array QuadTree::QuadNode::get_all_containing_point(const Vector2i &point, const Variant &exception_metadata) const {
-	Array result = Array();
-	for (size_t quad_rect_index = 0; quad_rect_index < quad_rects.size(); quad_rect_index++) {
-		Ref<QuadRect> quad_rect = quad_rects[quad_rect_index];
-		if (UtilityFunctions::type_of(exception_metadata) != GDEXTENSION_VARIANT_TYPE_NIL && quad_rect->get_metadata() == exception_metadata)
+void QuadTree::_collect_payloads(const int node_index, const uint32_t stamp, LocalVector<int> &r_payloads) const {
+	const NodeData &node = nodes[node_index];
+	for (int entry = node.first_entry; entry != -1; entry = entries[entry].next) {
+		const PayloadData &payload = payloads[entries[entry].payload];
+		if (payload.visit == stamp)
 			continue;
-		if (quad_rect->get_rect().has_point(point))
-			result.append(quad_rect);
+		payload.visit = stamp;
+		r_payloads.push_back(entries[entry].payload);
 	}
-	for (size_t quadrant_index = 0; quadrant_index < quadrants.size(); quadrant_index++) {
-		Ref<QuadNode> quadrant = quadrants[quadrant_index];
-		if (quadrant == nullptr)
-			continue;
-		if (!quadrant->rect.has_point(point))
-			continue;
-		result.append_array(quadrant->get_all_containing_point(point, exception_metadata));
+	for (int i = 0; i < 4; i++) {
+		if (node.children[i] != -1)
+			_collect_payloads(node.children[i], stamp, r_payloads);
 	}
-	return result;
 }
 
-void QuadTree::QuadNode::add(const Ref<QuadTree::QuadRect> &quad_rect) {
-	if (!can_subdivide(rect.size)) {
-		quad_rects.append(quad_rect);
-		return;
-	}
-	if (is_empty()) {
-		quad_rects.append(quad_rect);
+bool QuadTree::_is_node_empty(const int node_index) const {
+	return nodes[node_index].child_count == 0 && nodes[node_index].first_entry == -1;
+}
+
+void QuadTree::_add_to_node(const int node_index, const int payload) {
+	if (!QuadNode::can_subdivide(nodes[node_index].rect.size) || _is_node_empty(node_index)) {
+		nodes[node_index].first_entry = _alloc_entry(payload, nodes[node_index].first_entry);
 		return;
 	}
 
-	TypedArray<Rect2i> quadrant_rects = get_quadrant_rects(rect);
-	for (size_t i = 0; i < quadrant_rects.size(); i++) {
-		Rect2i quadrant_rect = quadrant_rects[i];
-		if (!quadrant_rect.intersects(quad_rect->get_rect()))
+	Rect2i quadrant_rects[4];
+	_get_quadrant_rects(nodes[node_index].rect, quadrant_rects);
+	Rect2i rect = payloads[payload].rect;
+	for (int i = 0; i < 4; i++) {
+		if (!quadrant_rects[i].intersects(rect))
 			continue;
-		Ref<QuadTree::QuadNode> quadrant = quadrants[i];
-		if (quadrant == nullptr) {
-			quadrants[i] = memnew(QuadNode());
-            quadrant = quadrants[i];
-            quadrant->set_rect(quadrant_rect);
-			quadrant_count += 1;
-			while (!quad_rects.is_empty()) {
-				Ref<QuadTree::QuadRect> new_quad_rect = quad_rects.pop_back();
-				add(new_quad_rect);
+		if (nodes[node_index].children[i] == -1) {
+			// Nodes may move while allocating, only indices are kept across calls.
+			int quadrant = _alloc_node(quadrant_rects[i]);
+			nodes[node_index].children[i] = quadrant;
+			nodes[node_index].child_count += 1;
+			while (nodes[node_index].first_entry != -1) {
+				int entry = nodes[node_index].first_entry;
+				int moved_payload = entries[entry].payload;
+				nodes[node_index].first_entry = entries[entry].next;
+				_free_entry(entry);
+				_add_to_node(node_index, moved_payload);
 			}
 		}
-        ERR_FAIL_NULL_MSG(quadrant, "'quadrant' is null.");
-		quadrant->add(quad_rect);
+		_add_to_node(nodes[node_index].children[i], payload);
 	}
 }
 
-bool QuadTree::QuadNode::remove(const Variant &metadata) {
+bool QuadTree::_remove_from_node(const int node_index, const int payload) {
 	bool result = false;
-	for (int i = (quad_rects.size() - 1); i >= 0; i--) {
-        ERR_FAIL_COND_V_MSG(i < 0 || i >= quad_rects.size(), result, "'quad_rects_index' is out of bounds.");
-		Ref<QuadRect> quad_rect = quad_rects[i];
-        ERR_FAIL_NULL_V_MSG(quad_rect, result, "'quad_rect' is null.");
-		if (quad_rect->get_metadata() == metadata) {
-			quad_rects.remove_at(i);
+	int previous = -1;
+	int entry = nodes[node_index].first_entry;
+	while (entry != -1) {
+		int next = entries[entry].next;
+		if (entries[entry].payload == payload) {
+			if (previous == -1) {
+				nodes[node_index].first_entry = next;
+			} else {
+				entries[previous].next = next;
+			}
+			_free_entry(entry);
 			result = true;
+		} else {
+			previous = entry;
 		}
+		entry = next;
 	}
 
-	for (size_t i = 0; i < quadrants.size(); i++) {
-		Ref<QuadNode> quad_node = quadrants[i];
-		if (quad_node == nullptr)
+	// Entries only go down into quadrants the rect overlaps.
+	Rect2i rect = payloads[payload].rect;
+	for (int i = 0; i < 4; i++) {
+		int quadrant = nodes[node_index].children[i];
+		if (quadrant == -1 || !nodes[quadrant].rect.intersects(rect))
 			continue;
-		if (quad_node->remove(metadata))
+		if (_remove_from_node(quadrant, payload))
 			result = true;
-		if (quad_node->is_empty()) {
-			quadrants[i] = nullptr;
-			quadrant_count -= 1;
+		if (_is_node_empty(quadrant)) {
+			_free_node(quadrant);
+			nodes[node_index].children[i] = -1;
+			nodes[node_index].child_count -= 1;
 		}
 	}
 
-	_collapse();
+	_collapse_node(node_index);
 
 	return result;
 }
 
-void QuadTree::QuadNode::_collapse() {
-	if (quadrant_count == 0)
+void QuadTree::_collapse_node(const int node_index) {
+	if (nodes[node_index].child_count == 0)
 		return;
-	Ref<QuadRect> collapsing_into = nullptr;
-	for (size_t node_index = 0; node_index < quadrants.size(); node_index++) {
-		Ref<QuadNode> quad_node = quadrants[node_index];
-		if (quad_node == nullptr)
+	int collapsing_into = -1;
+	for (int i = 0; i < 4; i++) {
+		int quadrant = nodes[node_index].children[i];
+		if (quadrant == -1)
 			continue;
-		if (quad_node->quadrant_count != 0)
+		if (nodes[quadrant].child_count != 0)
 			return;
-		for (size_t quad_rect_index = 0; quad_rect_index < quad_node->quad_rects.size(); quad_rect_index++) {
-			Ref<QuadRect> qtr = quad_node->quad_rects[quad_rect_index];
-			if (collapsing_into != nullptr && collapsing_into != qtr)
+		for (int entry = nodes[quadrant].first_entry; entry != -1; entry = entries[entry].next) {
+			int payload = entries[entry].payload;
+			if (collapsing_into != -1 && collapsing_into != payload)
 				return;
-			collapsing_into = qtr;
+			collapsing_into = payload;
 		}
 	}
-	for (size_t node_index = 0; node_index < quadrants.size(); node_index++) {
-		quadrants[node_index] = nullptr;
+	for (int i = 0; i < 4; i++) {
+		int quadrant = nodes[node_index].children[i];
+		if (quadrant != -1)
+			_free_node(quadrant);
+		nodes[node_index].children[i] = -1;
+	}
+	nodes[node_index].child_count = 0;
+	if (collapsing_into != -1)
+		nodes[node_index].first_entry = _alloc_entry(collapsing_into, nodes[node_index].first_entry);
+}
+
+bool QuadTree::_remove_payload(const int payload) {
+	bool result = root_index != -1 && _remove_from_node(root_index, payload);
+	payloads[payload].key = -1;
+	payloads[payload].next_in_key = free_payload;
+	free_payload = payload;
+	return result;
+}
+
+int QuadTree::_get_first_under_rect(const int node_index, const Rect2i &test_rect, const int exception_key) const {
+	const NodeData &node = nodes[node_index];
+	for (int entry = node.first_entry; entry != -1; entry = entries[entry].next) {
+		const PayloadData &payload = payloads[entries[entry].payload];
+		if (exception_key != -1 && payload.key == exception_key)
+			continue;
+		if (payload.rect.intersects(test_rect))
+			return entries[entry].payload;
+	}
+	for (int i = 0; i < 4; i++) {
+		int quadrant = node.children[i];
+		if (quadrant == -1 || !nodes[quadrant].rect.intersects(test_rect))
+			continue;
+		int first = _get_first_under_rect(quadrant, test_rect, exception_key);
+		if (first != -1)
+			return first;
+	}
+	return -1;
+}
+
+int QuadTree::_get_first_containing_point(const int node_index, const Vector2i &point, const int exception_key) const {
+	const NodeData &node = nodes[node_index];
+	for (int entry = node.first_entry; entry != -1; entry = entries[entry].next) {
+		const PayloadData &payload = payloads[entries[entry].payload];
+		if (exception_key != -1 && payload.key == exception_key)
+			continue;
+		if (payload.rect.has_point(point))
+			return entries[entry].payload;
+	}
+	for (int i = 0; i < 4; i++) {
+		int quadrant = node.children[i];
+		if (quadrant == -1 || !nodes[quadrant].rect.has_point(point))
+			continue;
+		int first = _get_first_containing_point(quadrant, point, exception_key);
+		if (first != -1)
+			return first;
+	}
+	return -1;
+}
+
+void QuadTree::_get_all_under_rect(const int node_index, const Rect2i &test_rect, const int exception_key, const uint32_t stamp, LocalVector<int> &r_payloads) const {
+	const NodeData &node = nodes[node_index];
+	for (int entry = node.first_entry; entry != -1; entry = entries[entry].next) {
+		const PayloadData &payload = payloads[entries[entry].payload];
+		if (payload.visit == stamp || (exception_key != -1 && payload.key == exception_key))
+			continue;
+		if (payload.rect.intersects(test_rect)) {
+			payload.visit = stamp;
+			r_payloads.push_back(entries[entry].payload);
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		int quadrant = node.children[i];
+		if (quadrant == -1 || !nodes[quadrant].rect.intersects(test_rect))
+			continue;
+		_get_all_under_rect(quadrant, test_rect, exception_key, stamp, r_payloads);
+	}
+}
+
+void QuadTree::_get_all_containing_point(const int node_index, const Vector2i &point, const int exception_key, const uint32_t stamp, LocalVector<int> &r_payloads) const {
+	const NodeData &node = nodes[node_index];
+	for (int entry = node.first_entry; entry != -1; entry = entries[entry].next) {
+		const PayloadData &payload = payloads[entries[entry].payload];
+		if (payload.visit == stamp || (exception_key != -1 && payload.key == exception_key))
+			continue;
+		if (payload.rect.has_point(point)) {
+			payload.visit = stamp;
+			r_payloads.push_back(entries[entry].payload);
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		int quadrant = node.children[i];
+		if (quadrant == -1 || !nodes[quadrant].rect.has_point(point))
+			continue;
+		_get_all_containing_point(quadrant, point, exception_key, stamp, r_payloads);
+	}
+}
+
+void QuadTree::_query_all(const Variant &at, const int exception_key, LocalVector<int> &r_payloads) const {
+	if (at.get_type() == Variant::RECT2I) {
+		_get_all_under_rect(root_index, at, exception_key, _begin_visit(), r_payloads);
+	} else if (at.get_type() == Variant::VECTOR2I) {
+		_get_all_containing_point(root_index, at, exception_key, _begin_visit(), r_payloads);
+	}
+}
+
+Ref<QuadTree::QuadRect> QuadTree::_make_quad_rect(const int payload) const {
+	if (payload == -1)
+		return nullptr;
+	Ref<QuadTree::QuadRect> quad_rect = memnew(QuadTree::QuadRect());
+	quad_rect->_init(payloads[payload].rect, keys[payloads[payload].key].metadata);
+	return quad_rect;
+}
+
+Array QuadTree::_make_quad_rects(const LocalVector<int> &payload_ids) const {
+	Array result = Array();
+	result.resize(payload_ids.size());
+	for (uint32_t i = 0; i < payload_ids.size(); i++) {
+		result[i] = _make_quad_rect(payload_ids[i]);
 	}
-	quadrant_count = 0;
-	quad_rects.append(collapsing_into);
+	return result;
 }
 
 void QuadTree::_bind_methods() {
     ClassDB::bind_method(D_METHOD("get_first", "at", "exception_metadata"), &QuadTree::get_first, DEFVAL(nullptr));
     ClassDB::bind_method(D_METHOD("get_all", "at", "exception_metadata"), &QuadTree::get_all, DEFVAL(nullptr));
+	ClassDB::bind_method(D_METHOD("fill_all_metadata", "at", "metadatas", "exception_metadata"), &QuadTree::fill_all_metadata, DEFVAL(nullptr));
     ClassDB::bind_method(D_METHOD("add", "rect", "metadata"), &QuadTree::add);
     ClassDB::bind_method(D_METHOD("remove", "metadata"), &QuadTree::remove);
     ClassDB::bind_method(D_METHOD("is_empty"), &QuadTree::is_empty);
+	ClassDB::bind_method(D_METHOD("build", "rects", "metadatas"), &QuadTree::build);
 
 	ClassDB::bind_method(D_METHOD("set_root", "root"), &QuadTree::set_root);
 	ClassDB::bind_method(D_METHOD("get_root"), &QuadTree::get_root);
@@ -331,53 +668,203 @@ QuadTree::~QuadTree() {
 }
 
 void QuadTree::init(const Vector2i &size) {
+	clear();
 	this->size = size;
-	Ref<QuadTree::QuadNode> new_node = memnew(QuadTree::QuadNode());
-    ERR_FAIL_NULL_MSG(new_node, "'new_node' is null.");
-	new_node->_init(Rect2i(Vector2i(0, 0), this->size));
-	set_root(new_node);
+	root_index = _alloc_node(Rect2i(Vector2i(0, 0), this->size));
+}
+
+void QuadTree::clear() {
+	nodes.clear();
+	entries.clear();
+	payloads.clear();
+	keys.clear();
+	free_node = -1;
+	free_entry = -1;
+	free_payload = -1;
+	free_key = -1;
+	key_indices.clear();
+	root_index = -1;
 }
 
 Ref<QuadTree::QuadRect> QuadTree::get_first(const Variant &at, const Variant &exception_metadata) const {
-	ERR_FAIL_NULL_V_MSG(this->root, nullptr, "'root' is null.");
-	if (UtilityFunctions::type_of(at) == GDEXTENSION_VARIANT_TYPE_RECT2I)
-		return this->root->get_first_under_rect(at, exception_metadata);
-	if (UtilityFunctions::type_of(at) == GDEXTENSION_VARIANT_TYPE_VECTOR2I)
-		return this->root->get_first_containing_point(at, exception_metadata);
+	ERR_FAIL_COND_V_MSG(root_index == -1, nullptr, "'root' is null.");
+	int exception_key = _get_exception_key(exception_metadata);
+	if (at.get_type() == Variant::RECT2I)
+		return _make_quad_rect(_get_first_under_rect(root_index, at, exception_key));
+	if (at.get_type() == Variant::VECTOR2I)
+		return _make_quad_rect(_get_first_containing_point(root_index, at, exception_key));
 	return nullptr;
 }
 
 Array QuadTree::get_all(const Variant &at, const Variant &exception_metadata) const {
-	ERR_FAIL_NULL_V_MSG(this->root, TypedArray<QuadTree::QuadRect>(), "'root' is null.");
-	if (UtilityFunctions::type_of(at) == GDEXTENSION_VARIANT_TYPE_RECT2I)
-		return this->root->get_all_under_rect(at, exception_metadata);
-	if (UtilityFunctions::type_of(at) == GDEXTENSION_VARIANT_TYPE_VECTOR2I)
-		return this->root->get_all_containing_point(at, exception_metadata);
-	return TypedArray<QuadTree::QuadRect>();
+	ERR_FAIL_COND_V_MSG(root_index == -1, Array(), "'root' is null.");
+	query_payloads.clear();
+	_query_all(at, _get_exception_key(exception_metadata), query_payloads);
+	return _make_quad_rects(query_payloads);
+}
+
+int QuadTree::fill_all_metadata(const Variant &at, Array r_metadatas, const Variant &exception_metadata) const {
+	ERR_FAIL_COND_V_MSG(root_index == -1, 0, "'root' is null.");
+	query_payloads.clear();
+	_query_all(at, _get_exception_key(exception_metadata), query_payloads);
+	// Arrays are shared, the caller's array is written in place and keeps its storage between calls.
+	r_metadatas.resize(query_payloads.size());
+	for (uint32_t i = 0; i < query_payloads.size(); i++) {
+		r_metadatas[i] = keys[payloads[query_payloads[i]].key].metadata;
+	}
+	return query_payloads.size();
 }
 
 void QuadTree::add(const Rect2i &rect, const Variant &metadata) {
-    ERR_FAIL_NULL_MSG(root, "'root node' is null.");
-	Ref<QuadTree::QuadRect> new_quad_rect = memnew(QuadTree::QuadRect());
-	new_quad_rect->_init(rect, metadata);
-	root->add(new_quad_rect);
+	add_payload(rect, metadata);
 }
 
 bool QuadTree::remove(const Variant &metadata) {
-    ERR_FAIL_NULL_V_MSG(root, false, "'root node' is null.");
-	return root->remove(metadata);
+    ERR_FAIL_COND_V_MSG(root_index == -1, false, "'root node' is null.");
+	const int *key_index = key_indices.getptr(metadata);
+	if (key_index == nullptr)
+		return false;
+	int key = *key_index;
+	bool result = false;
+	int payload = keys[key].first_payload;
+	while (payload != -1) {
+		int next = payloads[payload].next_in_key;
+		if (_remove_payload(payload))
+			result = true;
+		payload = next;
+	}
+	key_indices.erase(metadata);
+	keys[key].metadata = Variant();
+	keys[key].first_payload = -1;
+	keys[key].next_free = free_key;
+	free_key = key;
+	return result;
 }
 
 bool QuadTree::is_empty() const {
-    ERR_FAIL_NULL_V_MSG(root, true, "'root node' is null.");
-	return root->is_empty();
+    ERR_FAIL_COND_V_MSG(root_index == -1, true, "'root node' is null.");
+	return _is_node_empty(root_index);
+}
+
+void QuadTree::build(const TypedArray<Rect2i> &rects, const Array &metadatas) {
+	ERR_FAIL_COND_MSG(rects.size() != metadatas.size(), "'rects' and 'metadatas' must have the same size.");
+	LocalVector<Rect2i> rect_list;
+	LocalVector<Variant> metadata_list;
+	rect_list.resize(rects.size());
+	metadata_list.resize(rects.size());
+	for (int i = 0; i < rects.size(); i++) {
+		rect_list[i] = rects[i];
+		metadata_list[i] = metadatas[i];
+	}
+	build_from(rect_list, metadata_list);
+}
+
+void QuadTree::build_from(const LocalVector<Rect2i> &rects, const LocalVector<Variant> &metadatas) {
+	ERR_FAIL_COND_MSG(rects.size() != metadatas.size(), "'rects' and 'metadatas' must have the same size.");
+	Rect2i root_rect = root_index != -1 ? nodes[root_index].rect : Rect2i(Vector2i(0, 0), size);
+	clear();
+	root_index = _alloc_node(root_rect);
+	payloads.reserve(rects.size());
+	LocalVector<int> scratch;
+	scratch.reserve(rects.size() * 2);
+	for (uint32_t i = 0; i < rects.size(); i++) {
+		scratch.push_back(_register_payload(rects[i], metadatas[i]));
+	}
+	_build_node(root_index, scratch, 0, scratch.size());
+}
+
+int QuadTree::add_payload(const Rect2i &rect, const Variant &metadata) {
+    ERR_FAIL_COND_V_MSG(root_index == -1, -1, "'root node' is null.");
+	return _add_payload(rect, metadata, root_index);
+}
+
+int QuadTree::find_key(const Variant &metadata) const {
+	const int *key = key_indices.getptr(metadata);
+	if (key == nullptr)
+		return -1;
+	return *key;
+}
+
+int QuadTree::get_first_id(const Rect2i &rect, const int exception_key) const {
+	if (root_index == -1)
+		return -1;
+	return _get_first_under_rect(root_index, rect, exception_key);
+}
+
+int QuadTree::get_first_id(const Vector2i &point, const int exception_key) const {
+	if (root_index == -1)
+		return -1;
+	return _get_first_containing_point(root_index, point, exception_key);
+}
+
+void QuadTree::get_all_ids(const Rect2i &rect, LocalVector<int> &r_payloads, const int exception_key) const {
+	if (root_index == -1)
+		return;
+	_get_all_under_rect(root_index, rect, exception_key, _begin_visit(), r_payloads);
+}
+
+void QuadTree::get_all_ids(const Vector2i &point, LocalVector<int> &r_payloads, const int exception_key) const {
+	if (root_index == -1)
+		return;
+	_get_all_containing_point(root_index, point, exception_key, _begin_visit(), r_payloads);
+}
+
+int QuadTree::get_all_ids(const Variant &at, PackedInt32Array &r_ids, const Variant &exception_metadata) const {
+	ERR_FAIL_COND_V_MSG(root_index == -1, 0, "'root' is null.");
+	query_payloads.clear();
+	_query_all(at, _get_exception_key(exception_metadata), query_payloads);
+	r_ids.resize(query_payloads.size());
+	int32_t *ids = r_ids.ptrw();
+	for (uint32_t i = 0; i < query_payloads.size(); i++) {
+		ids[i] = query_payloads[i];
+	}
+	return query_payloads.size();
+}
+
+Rect2i QuadTree::get_payload_rect(const int payload) const {
+	ERR_FAIL_COND_V_MSG(payload < 0 || payload >= (int)payloads.size() || payloads[payload].key == -1, Rect2i(), "'payload' is not in the tree.");
+	return payloads[payload].rect;
+}
+
+Variant QuadTree::get_payload_metadata(const int payload) const {
+	ERR_FAIL_COND_V_MSG(payload < 0 || payload >= (int)payloads.size() || payloads[payload].key == -1, Variant(), "'payload' is not in the tree.");
+	return keys[payloads[payload].key].metadata;
 }
 
 void QuadTree::set_root(const Ref<QuadNode> &new_root) {
-	root = new_root;
+	if (new_root == nullptr || !new_root->_has_node()) {
+		clear();
+		if (new_root != nullptr)
+			root_index = _alloc_node(new_root->get_rect());
+		return;
+	}
+	if (new_root->tree.ptr() == this && new_root->node_index == root_index)
+		return;
+
+	// Copy out first, the node may belong to this tree.
+	Rect2i root_rect = new_root->get_rect();
+	Ref<QuadTree> source = new_root->tree;
+	LocalVector<int> payload_ids;
+	source->_collect_payloads(new_root->node_index, source->_begin_visit(), payload_ids);
+	LocalVector<Rect2i> rects;
+	Array metadatas;
+	for (uint32_t i = 0; i < payload_ids.size(); i++) {
+		rects.push_back(source->get_payload_rect(payload_ids[i]));
+		metadatas.append(source->get_payload_metadata(payload_ids[i]));
+	}
+
+	clear();
+	root_index = _alloc_node(root_rect);
+	for (uint32_t i = 0; i < rects.size(); i++) {
+		_add_payload(rects[i], metadatas[i], root_index);
+	}
 }
 
 Ref<QuadTree::QuadNode> QuadTree::get_root() const {
+	if (root_index == -1)
+		return nullptr;
+	Ref<QuadTree::QuadNode> root = memnew(QuadTree::QuadNode());
+	root->_set_view(Ref<QuadTree>(const_cast<QuadTree *>(this)), root_index);
 	return root;
 }
 
@@ -2,6 +2,8 @@
 #define QUAD_TREE_CLASS_H
 
 #include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
 using namespace godot;
 
@@ -14,7 +16,7 @@ public:
     private:
 		Rect2i rect;
 		Variant metadata;
-        
+
 	protected:
 		static void _bind_methods();
 
@@ -27,14 +29,17 @@ public:
 		String to_string() const;
 	};
 
+	// View over one node of a tree, it goes stale once the tree frees that node.
+	// Nodes created on their own get a private tree.
 	class QuadNode : public RefCounted {
         GDCLASS(QuadNode, RefCounted);
 	private:
-		TypedArray<QuadNode> quadrants = TypedArray<QuadNode>();
-		int quadrant_count = 0;
-		TypedArray<QuadRect> quad_rects;
-		Rect2i rect;
-        
+		Ref<QuadTree> tree;
+		int node_index = -1;
+		Rect2i pending_rect;
+		void _ensure_tree();
+		bool _has_node() const;
+
 	protected:
 		static void _bind_methods();
 
@@ -44,6 +49,7 @@ public:
 		static bool can_subdivide(const Vector2i &size);
 		static TypedArray<Rect2i> get_quadrant_rects(const Rect2i &rect);
 		void _init(const Rect2i &rect);
+		void _set_view(const Ref<QuadTree> &tree, const int node_index);
         void set_quadrants(const TypedArray<QuadNode> &new_quadrants);
 	    TypedArray<QuadNode> get_quadrants() const;
         void set_quadrant_count(const int &new_quadrant_count);
@@ -64,8 +70,71 @@ public:
 	};
 
 private:
-	Ref<QuadNode> root;
+	// Flat core. Nodes, entries, payloads and keys live in pools indexed by int and
+	// are recycled through free lists, queries walk them without allocating.
+	// A payload is one added rect, a key is one distinct metadata value and links
+	// the payloads added with it. Entries place a payload in the nodes it overlaps.
+	struct NodeData {
+		Rect2i rect;
+		int children[4] = { -1, -1, -1, -1 };
+		int child_count = 0;
+		int first_entry = -1;
+		int next_free = -1;
+	};
+	struct EntryData {
+		int payload = -1;
+		int next = -1;
+	};
+	struct PayloadData {
+		Rect2i rect;
+		int key = -1;
+		int next_in_key = -1;
+		// Stamp of the last query that reported this payload, dedupes rects split over nodes.
+		mutable uint32_t visit = 0;
+	};
+	struct KeyData {
+		Variant metadata;
+		int first_payload = -1;
+		int next_free = -1;
+	};
+	LocalVector<NodeData> nodes;
+	LocalVector<EntryData> entries;
+	LocalVector<PayloadData> payloads;
+	LocalVector<KeyData> keys;
+	int free_node = -1;
+	int free_entry = -1;
+	int free_payload = -1;
+	int free_key = -1;
+	HashMap<Variant, int, VariantHasher, VariantComparator> key_indices;
+	int root_index = -1;
 	Vector2i size;
+	mutable uint32_t visit_stamp = 0;
+	// Reused by the wrappers returning arrays, so repeated queries keep its capacity.
+	mutable LocalVector<int> query_payloads;
+
+	static void _get_quadrant_rects(const Rect2i &rect, Rect2i *r_quadrants);
+	int _alloc_node(const Rect2i &rect);
+	void _free_node(const int node_index);
+	int _alloc_entry(const int payload, const int next);
+	void _free_entry(const int entry);
+	int _register_payload(const Rect2i &rect, const Variant &metadata);
+	int _add_payload(const Rect2i &rect, const Variant &metadata, const int node_index);
+	void _build_node(const int node_index, LocalVector<int> &r_scratch, const uint32_t begin, const uint32_t end);
+	int _get_exception_key(const Variant &exception_metadata) const;
+	uint32_t _begin_visit() const;
+	void _collect_payloads(const int node_index, const uint32_t stamp, LocalVector<int> &r_payloads) const;
+	bool _is_node_empty(const int node_index) const;
+	void _add_to_node(const int node_index, const int payload);
+	bool _remove_from_node(const int node_index, const int payload);
+	void _collapse_node(const int node_index);
+	bool _remove_payload(const int payload);
+	int _get_first_under_rect(const int node_index, const Rect2i &test_rect, const int exception_key) const;
+	int _get_first_containing_point(const int node_index, const Vector2i &point, const int exception_key) const;
+	void _get_all_under_rect(const int node_index, const Rect2i &test_rect, const int exception_key, const uint32_t stamp, LocalVector<int> &r_payloads) const;
+	void _get_all_containing_point(const int node_index, const Vector2i &point, const int exception_key, const uint32_t stamp, LocalVector<int> &r_payloads) const;
+	void _query_all(const Variant &at, const int exception_key, LocalVector<int> &r_payloads) const;
+	Ref<QuadRect> _make_quad_rect(const int payload) const;
+	Array _make_quad_rects(const LocalVector<int> &payload_ids) const;
 
 protected:
 	static void _bind_methods();
@@ -74,11 +143,32 @@ public:
     QuadTree();
     ~QuadTree();
 	void init(const Vector2i &size);
+	void clear();
 	Ref<QuadTree::QuadRect> get_first(const Variant &at, const Variant &exception_metadata = nullptr) const;
 	Array get_all(const Variant &at, const Variant &exception_metadata = nullptr) const;
+	// Like get_all, but writes the metadata of the matches into r_metadatas and returns their count.
+	int fill_all_metadata(const Variant &at, Array r_metadatas, const Variant &exception_metadata = nullptr) const;
 	void add(const Rect2i &rect, const Variant &metadata);
 	bool remove(const Variant &metadata);
 	bool is_empty() const;
+	void build(const TypedArray<Rect2i> &rects, const Array &metadatas);
+	// Replaces the contents with all the rects at once, splitting each node a single time.
+	void build_from(const LocalVector<Rect2i> &rects, const LocalVector<Variant> &metadatas);
+
+	// Integer core used by the wrappers above. Payload ids stay valid until removed.
+	int add_payload(const Rect2i &rect, const Variant &metadata);
+	int find_key(const Variant &metadata) const;
+	int get_first_id(const Rect2i &rect, const int exception_key = -1) const;
+	int get_first_id(const Vector2i &point, const int exception_key = -1) const;
+	// Appends the ids of matching payloads once each, the caller clears r_payloads.
+	void get_all_ids(const Rect2i &rect, LocalVector<int> &r_payloads, const int exception_key = -1) const;
+	void get_all_ids(const Vector2i &point, LocalVector<int> &r_payloads, const int exception_key = -1) const;
+	// Same query as get_all, writes the payload ids into r_ids and returns their count.
+	// Packed arrays are copied on write once they reach a script, so this one is not
+	// bound, scripts use fill_all_metadata.
+	int get_all_ids(const Variant &at, PackedInt32Array &r_ids, const Variant &exception_metadata = nullptr) const;
+	Rect2i get_payload_rect(const int payload) const;
+	Variant get_payload_metadata(const int payload) const;
 
 	void set_root(const Ref<QuadNode> &new_root);
 	Ref<QuadNode> get_root() const;
@@ -1,4 +1,5 @@
 #include "craft_station.h"
+#include "crafting_scheduler.h"
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
@@ -25,30 +26,69 @@ int Crafting::get_recipe_index() const {
 
 void Crafting::set_time(const float &new_time) {
 	time = new_time;
+	if (is_scheduled()) {
+		due_time = CraftingScheduler::get_singleton()->get_clock(clock) + new_time;
+		// The station running it has to move its wake-up to the new due time.
+		emit_changed();
+	}
 }
 
 float Crafting::get_time() const {
+	if (is_scheduled())
+		return due_time - CraftingScheduler::get_singleton()->get_clock(clock);
 	return time;
 }
 
 bool Crafting::is_finished() const {
+	if (is_scheduled())
+		return due_time <= CraftingScheduler::get_singleton()->get_clock(clock);
 	return time <= 0;
 }
 
 void Crafting::process(float delta) {
+	if (is_scheduled()) {
+		due_time -= delta;
+		return;
+	}
 	time -= delta;
 }
 
+void Crafting::schedule(const int new_clock) {
+	ERR_FAIL_NULL_MSG(CraftingScheduler::get_singleton(), "'CraftingScheduler' is null.");
+	unschedule();
+	clock = new_clock;
+	due_time = CraftingScheduler::get_singleton()->get_clock(clock) + time;
+}
+
+void Crafting::unschedule() {
+	if (!is_scheduled())
+		return;
+	time = get_time();
+	clock = -1;
+}
+
+bool Crafting::is_scheduled() const {
+	return clock != -1 && CraftingScheduler::get_singleton() != nullptr;
+}
+
+int Crafting::get_clock() const {
+	return clock;
+}
+
+double Crafting::get_due_time() const {
+	return due_time;
+}
+
 Dictionary Crafting::serialize() const {
 	Dictionary dict = Dictionary();
 	dict["recipe_index"] = recipe_index;
-	dict["time"] = time;
+	dict["time"] = get_time();
 	return dict;
 }
 
 void Crafting::deserialize(const Dictionary data) {
 	recipe_index = data["recipe_index"];
-	time = data["time"];
+	set_time(data["time"]);
 }
 
 CraftStation::CraftStation() {
@@ -171,17 +211,28 @@ void CraftStation::finish_crafting(int crafting_index) {
 		}
 		_use_items(recipe);
 	}
-	for (size_t i = 0; i < recipe->get_products().size(); i++) {
-		Ref<ItemStack> product = recipe->get_products()[i];
-		int amount_to_add = product->get_amount();
-		for (size_t i = 0; i < output_inventories.size(); i++) {
-			Inventory *inventory = get_output_inventory(i);
-			if (inventory == nullptr) {
-				ERR_PRINT("Passed object is not a Inventory!");
-				return;
-			}
-			Dictionary properties = get_database()->create_dynamic_properties(product->get_item_id());
-			amount_to_add = inventory->add(product->get_item_id(), product->get_amount(), properties, true);
+	TypedArray<ItemStack> products = recipe->get_products();
+	PackedStringArray product_ids;
+	PackedInt32Array product_amounts;
+	for (size_t i = 0; i < products.size(); i++) {
+		Ref<ItemStack> product = products[i];
+		product_ids.append(product->get_item_id());
+		product_amounts.append(product->get_amount());
+	}
+	for (size_t i = 0; i < output_inventories.size(); i++) {
+		Inventory *inventory = get_output_inventory(i);
+		if (inventory == nullptr) {
+			ERR_PRINT("Passed object is not a Inventory!");
+			return;
+		}
+		Array properties;
+		for (size_t j = 0; j < product_ids.size(); j++) {
+			properties.append(get_database()->create_dynamic_properties(product_ids[j]));
+		}
+		PackedInt32Array not_added = inventory->add_many(product_ids, product_amounts, properties);
+		for (size_t j = 0; j < not_added.size(); j++) {
+			if (not_added[j] > 0)
+				inventory->drop(product_ids[j], not_added[j], properties[j]);
 		}
 	}
 	emit_signal("on_crafted", crafting->get_recipe_index());
@@ -219,13 +270,16 @@ void CraftStation::add_crafting(int recipe_index, const Ref<Recipe> &recipe) {
 	crafting->set_recipe_index(recipe_index);
 	crafting->set_time(recipe->get_time_to_craft());
 	craftings.append(crafting);
+	_schedule_craftings();
 	emit_signal("crafting_added", craftings.size() - 1);
 }
 
 void CraftStation::remove_crafting(int crafting_index) {
 	ERR_FAIL_COND_MSG(crafting_index < 0 || crafting_index >= craftings.size(), "Crafting Index incorrect!");
 
+	_unschedule_crafting(craftings[crafting_index]);
 	craftings.remove_at(crafting_index);
+	_schedule_craftings();
 	emit_signal("crafting_removed", crafting_index);
 }
 
@@ -238,11 +292,19 @@ void CraftStation::_on_input_inventory_contents_changed() {
 	ERR_FAIL_NULL_MSG(get_database(), "Database is null.");
 
 	if (only_remove_ingredients_after_craft) {
+		_refresh_recipe_readiness();
 		int i = 0;
 		while (i < craftings.size()) {
 			Ref<Crafting> crafting = craftings[i];
-			Ref<Recipe> recipe = get_database()->get_recipes()[crafting->get_recipe_index()];
-			if (!contains_ingredients(recipe)) {
+			const int *needs_position = recipe_needs_by_index.getptr(crafting->get_recipe_index());
+			bool has_ingredients;
+			if (needs_position != nullptr) {
+				has_ingredients = recipe_needs[*needs_position].missing == 0;
+			} else {
+				Ref<Recipe> recipe = get_database()->get_recipes()[crafting->get_recipe_index()];
+				has_ingredients = contains_ingredients(recipe);
+			}
+			if (!has_ingredients) {
 				cancel_craft(i);
 				continue;
 			}
@@ -261,14 +323,173 @@ void CraftStation::_check_auto_crafts() {
 		return;
 	if (!auto_craft)
 		return;
-	for (size_t i = 0; i < valid_recipes.size(); i++) {
-		Ref<Recipe> recipe = get_database()->get_recipes()[valid_recipes[i]];
+	_refresh_recipe_readiness();
+	TypedArray<Recipe> recipes = get_database()->get_recipes();
+	// Only recipes with every need met are worth the full check.
+	for (uint32_t i = 0; i < recipe_needs.size(); i++) {
+		if (recipe_needs[i].missing > 0)
+			continue;
+		Ref<Recipe> recipe = recipes[recipe_needs[i].recipe_index];
 		if (!can_craft(recipe))
 			continue;
-		craft(valid_recipes[i]);
+		craft(recipe_needs[i].recipe_index);
+	}
+}
+
+void CraftStation::_rebuild_recipe_readiness() {
+	tracked_items.clear();
+	tracked_item_slots.clear();
+	recipe_needs.clear();
+	recipe_needs_by_index.clear();
+	readiness_dirty = false;
+	_clear_reported_changes();
+	Ref<InventoryDatabase> database = get_database();
+	if (database == nullptr)
+		return;
+	TypedArray<Recipe> recipes = database->get_recipes();
+	for (int i = 0; i < valid_recipes.size(); i++) {
+		int recipe_index = valid_recipes[i];
+		if (recipe_index < 0 || recipe_index >= recipes.size())
+			continue;
+		Ref<Recipe> recipe = recipes[recipe_index];
+		if (recipe == nullptr)
+			continue;
+		RecipeNeeds needs;
+		needs.recipe_index = recipe_index;
+		_add_recipe_needs(needs, recipe->get_ingredients(), recipe_needs.size());
+		_add_recipe_needs(needs, recipe->get_required_items(), recipe_needs.size());
+		recipe_needs_by_index.insert(recipe_index, recipe_needs.size());
+		recipe_needs.push_back(needs);
+	}
+	for (uint32_t i = 0; i < tracked_items.size(); i++) {
+		tracked_items[i].total = _get_input_amount(tracked_items[i].item_id);
+	}
+	for (uint32_t i = 0; i < recipe_needs.size(); i++) {
+		_count_missing_needs(recipe_needs[i]);
+	}
+}
+
+void CraftStation::_refresh_recipe_readiness() {
+	if (readiness_dirty) {
+		_rebuild_recipe_readiness();
+		return;
+	}
+	if (readiness_edit_revision != _get_inputs_edit_revision())
+		readiness_needs_compare = true;
+	if (readiness_needs_compare || !readiness_changes_reported) {
+		for (uint32_t i = 0; i < tracked_items.size(); i++) {
+			_refresh_tracked_item(i);
+		}
+	} else {
+		for (uint32_t i = 0; i < changed_tracked_items.size(); i++) {
+			_refresh_tracked_item(changed_tracked_items[i]);
+		}
+	}
+	_clear_reported_changes();
+}
+
+void CraftStation::_refresh_tracked_item(const int item_slot) {
+	TrackedItem &tracked_item = tracked_items[item_slot];
+	int total = _get_input_amount(tracked_item.item_id);
+	if (total == tracked_item.total)
+		return;
+	tracked_item.total = total;
+	for (uint32_t i = 0; i < tracked_item.recipes.size(); i++) {
+		_count_missing_needs(recipe_needs[tracked_item.recipes[i]]);
+	}
+}
+
+void CraftStation::_clear_reported_changes() {
+	for (uint32_t i = 0; i < changed_tracked_items.size(); i++) {
+		if (changed_tracked_items[i] < (int)tracked_items.size())
+			tracked_items[changed_tracked_items[i]].changed = false;
+	}
+	changed_tracked_items.clear();
+	readiness_changes_reported = false;
+	readiness_needs_compare = false;
+	readiness_edit_revision = _get_inputs_edit_revision();
+}
+
+uint64_t CraftStation::_get_inputs_edit_revision() const {
+	// Every revision only grows, so the sum moves when any input's stacks were edited.
+	uint64_t edit_revision = 0;
+	for (int i = 0; i < input_inventories.size(); i++) {
+		Inventory *inventory = get_input_inventory(i);
+		if (inventory != nullptr)
+			edit_revision += inventory->get_stacks_edit_revision();
+	}
+	return edit_revision;
+}
+
+void CraftStation::_mark_input_item_changed(const String &item_id) {
+	readiness_changes_reported = true;
+	if (readiness_dirty)
+		return;
+	const int *item_slot = tracked_item_slots.getptr(item_id);
+	if (item_slot == nullptr || tracked_items[*item_slot].changed)
+		return;
+	tracked_items[*item_slot].changed = true;
+	changed_tracked_items.push_back(*item_slot);
+}
+
+void CraftStation::_on_input_item_changed(const String &item_id, const int amount) {
+	_mark_input_item_changed(item_id);
+}
+
+void CraftStation::_on_input_batch_committed(const PackedInt32Array &changed_stacks, const PackedStringArray &item_ids, const PackedInt32Array &item_deltas, const PackedInt32Array &added_stacks, const PackedInt32Array &removed_stacks) {
+	for (int i = 0; i < item_ids.size(); i++) {
+		_mark_input_item_changed(item_ids[i]);
+	}
+}
+
+void CraftStation::_on_input_stacks_swapped(const int stack_index, Object *other_inventory, const int other_stack_index) {
+	readiness_needs_compare = true;
+}
+
+void CraftStation::_add_recipe_needs(RecipeNeeds &needs, const TypedArray<ItemStack> &item_stacks, const int needs_position) {
+	for (int i = 0; i < item_stacks.size(); i++) {
+		Ref<ItemStack> item_stack = item_stacks[i];
+		if (item_stack == nullptr)
+			continue;
+		const int *slot = tracked_item_slots.getptr(item_stack->get_item_id());
+		int item_slot;
+		if (slot != nullptr) {
+			item_slot = *slot;
+		} else {
+			item_slot = tracked_items.size();
+			tracked_item_slots.insert(item_stack->get_item_id(), item_slot);
+			TrackedItem tracked_item;
+			tracked_item.item_id = item_stack->get_item_id();
+			tracked_items.push_back(tracked_item);
+		}
+		needs.items.push_back(item_slot);
+		needs.amounts.push_back(item_stack->get_amount());
+		LocalVector<int> &recipes = tracked_items[item_slot].recipes;
+		if (recipes.is_empty() || recipes[recipes.size() - 1] != needs_position)
+			recipes.push_back(needs_position);
+	}
+}
+
+void CraftStation::_count_missing_needs(RecipeNeeds &needs) const {
+	needs.missing = 0;
+	for (uint32_t i = 0; i < needs.items.size(); i++) {
+		if (tracked_items[needs.items[i]].total < needs.amounts[i])
+			needs.missing++;
 	}
 }
 
+int CraftStation::_get_input_amount(const String &item_id) const {
+	int amount_total = 0;
+	for (int i = 0; i < input_inventories.size(); i++) {
+		Inventory *inventory = get_input_inventory(i);
+		// Like contains_ingredients, a missing input meets no need, even of zero items.
+		if (inventory == nullptr)
+			return -1;
+		amount_total += inventory->amount_of_item(item_id);
+	}
+	return amount_total;
+}
+
 void CraftStation::_ready() {
 	if (Engine::get_singleton()->is_editor_hint())
 		return;
@@ -278,6 +499,34 @@ void CraftStation::_ready() {
 	load_valid_recipes();
 	_setup_connections();
 	NodeInventories::_ready();
+	// The CraftingScheduler ticks the craftings, the station only runs when one is due.
+	if (CraftingScheduler::get_singleton() != nullptr)
+		set_process(false);
+	_schedule_craftings();
+}
+
+void CraftStation::_notification(int p_what) {
+	switch (p_what) {
+		// Paused or disabled craftings keep their remaining time off the scheduler clocks.
+		case NOTIFICATION_PAUSED:
+		case NOTIFICATION_DISABLED: {
+			_unschedule_craftings();
+		} break;
+		case NOTIFICATION_UNPAUSED:
+		case NOTIFICATION_ENABLED: {
+			if (is_node_ready())
+				_schedule_craftings();
+		} break;
+	}
+}
+
+void CraftStation::_enter_tree() {
+	if (is_node_ready())
+		_schedule_craftings();
+}
+
+void CraftStation::_exit_tree() {
+	_unschedule_craftings();
 }
 
 void CraftStation::_setup_connections() {
@@ -288,6 +537,11 @@ void CraftStation::_setup_connections() {
 			continue;
 		}
 		inventory->connect("contents_changed", callable_mp(this, &CraftStation::_on_input_inventory_contents_changed));
+		inventory->connect("item_added", callable_mp(this, &CraftStation::_on_input_item_changed));
+		inventory->connect("item_removed", callable_mp(this, &CraftStation::_on_input_item_changed));
+		inventory->connect("batch_committed", callable_mp(this, &CraftStation::_on_input_batch_committed));
+		if (inventory->has_signal("stacks_swapped"))
+			inventory->connect("stacks_swapped", callable_mp(this, &CraftStation::_on_input_stacks_swapped));
 	}
 }
 
@@ -295,16 +549,11 @@ void CraftStation::load_valid_recipes() {
 	type = get_database()->get_craft_station_from_id(type_id);
 
 	valid_recipes.clear();
-	for (int i = 0; i < get_database()->get_recipes().size(); i++) {
-		Ref<Recipe> recipe = get_database()->get_recipes()[i];
-		String recipe_craft_id = "";
-		if (recipe->get_station() != nullptr) {
-			recipe_craft_id = recipe->get_station()->get_id();
-		}
-		if (recipe_craft_id == type_id) {
-			valid_recipes.append(i);
-		}
+	PackedInt32Array recipe_indices = get_database()->get_recipes_for_station(type_id);
+	for (int i = 0; i < recipe_indices.size(); i++) {
+		valid_recipes.append(recipe_indices[i]);
 	}
+	readiness_dirty = true;
 }
 
 void CraftStation::tick(float delta) {
@@ -315,21 +564,98 @@ void CraftStation::tick(float delta) {
 	if (craftings.is_empty())
 		return;
 	_process_crafts(delta);
-	if (!can_finish_craftings)
-		return;
-	for (size_t i = 0; i < craftings.size(); i++) {
+	if (can_finish_craftings)
+		_finish_due_craftings();
+	// A manual tick moves the due times, the wake-up has to follow them.
+	if (_uses_scheduler())
+		_schedule_craftings();
+}
+
+void CraftStation::wake_craftings() {
+	if (can_finish_craftings)
+		_finish_due_craftings();
+	_schedule_craftings();
+}
+
+void CraftStation::_finish_due_craftings() {
+	// Every finished crafting completes in the same frame. Finishing removes the
+	// crafting and may add new ones, so the scan stays on the index it removed.
+	int i = 0;
+	while (i < craftings.size()) {
 		Ref<Crafting> crafting = craftings[i];
-		if (crafting->is_finished()) {
+		if (crafting != nullptr && crafting->is_finished()) {
 			finish_crafting(i);
-			return;
+			if (i < craftings.size() && Ref<Crafting>(craftings[i]) != crafting)
+				continue;
+		}
+		i++;
+	}
+}
+
+bool CraftStation::_uses_scheduler() const {
+	return tick_update_method != TickUpdateMethod::CUSTOM && CraftingScheduler::get_singleton() != nullptr && is_inside_tree() && !Engine::get_singleton()->is_editor_hint() && can_process();
+}
+
+void CraftStation::_schedule_craftings() {
+	if (!_uses_scheduler()) {
+		_unschedule_craftings();
+		return;
+	}
+	CraftingScheduler *scheduler = CraftingScheduler::get_singleton();
+	scheduler->connect_tree(get_tree());
+	bool has_due_time = false;
+	double next_due_time = 0.0;
+	for (int i = 0; i < craftings.size(); i++) {
+		Ref<Crafting> crafting = craftings[i];
+		if (crafting == nullptr)
+			continue;
+		bool is_running = can_processing_craftings && (processing_mode == ProcessingMode::PARALLEL || i == 0);
+		if (!is_running) {
+			_unschedule_crafting(crafting);
+			continue;
 		}
+		if (!crafting->is_scheduled() || crafting->get_clock() != tick_update_method) {
+			crafting->schedule(tick_update_method);
+			Callable on_changed = callable_mp(this, &CraftStation::_on_crafting_changed);
+			if (!crafting->is_connected("changed", on_changed))
+				crafting->connect("changed", on_changed);
+		}
+		if (!has_due_time || crafting->get_due_time() < next_due_time) {
+			next_due_time = crafting->get_due_time();
+			has_due_time = true;
+		}
+	}
+	if (has_due_time && can_finish_craftings)
+		scheduler->schedule(this, next_due_time, tick_update_method);
+	else
+		scheduler->unschedule(this);
+}
+
+void CraftStation::_unschedule_craftings() {
+	for (int i = 0; i < craftings.size(); i++) {
+		_unschedule_crafting(craftings[i]);
 	}
+	if (CraftingScheduler::get_singleton() != nullptr)
+		CraftingScheduler::get_singleton()->unschedule(this);
+}
+
+void CraftStation::_unschedule_crafting(const Ref<Crafting> &crafting) {
+	if (crafting == nullptr)
+		return;
+	crafting->unschedule();
+	Callable on_changed = callable_mp(this, &CraftStation::_on_crafting_changed);
+	if (crafting->is_connected("changed", on_changed))
+		crafting->disconnect("changed", on_changed);
+}
+
+void CraftStation::_on_crafting_changed() {
+	_schedule_craftings();
 }
 
 void CraftStation::_process(float delta) {
 	if (Engine::get_singleton()->is_editor_hint())
 		return;
-	if (tick_update_method == TickUpdateMethod::PROCESS) {
+	if (tick_update_method == TickUpdateMethod::PROCESS && !_uses_scheduler()) {
 		tick(delta);
 	}
 }
@@ -337,7 +663,7 @@ void CraftStation::_process(float delta) {
 void CraftStation::_physic_process(float delta) {
 	if (Engine::get_singleton()->is_editor_hint())
 		return;
-	if (tick_update_method == TickUpdateMethod::PHYSIC_PROCESS) {
+	if (tick_update_method == TickUpdateMethod::PHYSIC_PROCESS && !_uses_scheduler()) {
 		tick(delta);
 	}
 }
@@ -449,6 +775,7 @@ Inventory *CraftStation::get_output_inventory(const int &index) const {
 
 void CraftStation::set_input_inventories(const TypedArray<NodePath> &new_input_inventories) {
 	input_inventories = new_input_inventories;
+	readiness_dirty = true;
 }
 
 TypedArray<NodePath> CraftStation::get_input_inventories() const {
@@ -482,6 +809,8 @@ int CraftStation::get_limit_number_crafts() const {
 
 void CraftStation::set_can_processing_craftings(const bool &new_can_processing_craftings) {
 	can_processing_craftings = new_can_processing_craftings;
+	if (is_node_ready())
+		_schedule_craftings();
 }
 
 bool CraftStation::get_can_processing_craftings() const {
@@ -490,6 +819,8 @@ bool CraftStation::get_can_processing_craftings() const {
 
 void CraftStation::set_can_finish_craftings(const bool &new_can_finish_craftings) {
 	can_finish_craftings = new_can_finish_craftings;
+	if (is_node_ready())
+		_schedule_craftings();
 }
 
 bool CraftStation::get_can_finish_craftings() const {
@@ -538,6 +869,8 @@ bool CraftStation::get_auto_craft() const {
 
 void CraftStation::set_processing_mode(const int &new_processing_mode) {
 	processing_mode = new_processing_mode;
+	if (is_node_ready())
+		_schedule_craftings();
 }
 
 int CraftStation::get_processing_mode() const {
@@ -546,6 +879,8 @@ int CraftStation::get_processing_mode() const {
 
 void CraftStation::set_tick_update_method(const int &new_tick_update_method) {
 	tick_update_method = new_tick_update_method;
+	if (is_node_ready())
+		_schedule_craftings();
 }
 
 int CraftStation::get_tick_update_method() const {
@@ -553,7 +888,10 @@ int CraftStation::get_tick_update_method() const {
 }
 
 void CraftStation::set_craftings(const TypedArray<Crafting> &new_craftings) {
+	_unschedule_craftings();
 	craftings = new_craftings;
+	if (is_node_ready())
+		_schedule_craftings();
 }
 
 TypedArray<Crafting> CraftStation::get_craftings() const {
@@ -562,6 +900,7 @@ TypedArray<Crafting> CraftStation::get_craftings() const {
 
 void CraftStation::set_valid_recipes(const TypedArray<int> &new_valid_recipes) {
 	valid_recipes = new_valid_recipes;
+	readiness_dirty = true;
 }
 
 TypedArray<int> CraftStation::get_valid_recipes() const {
@@ -573,6 +912,7 @@ void CraftStation::add_input_inventory(Inventory *input_inventory) {
 
 	NodePath path = get_path_to(input_inventory);
 	input_inventories.append(path);
+	readiness_dirty = true;
 	emit_signal("input_inventory_added", path);
 }
 
@@ -584,6 +924,7 @@ void CraftStation::remove_input_inventory(Inventory *input_inventory) {
 	if (index == -1)
 		return;
 	input_inventories.remove_at(index);
+	readiness_dirty = true;
 	emit_signal("input_inventory_removed", path);
 }
 
@@ -615,6 +956,9 @@ void CraftStation::deserialize(const Dictionary data) {
 	}
 	int size = craftings.size();
 	for (size_t slot_index = craftings_data.size(); slot_index < size; slot_index++) {
+		_unschedule_crafting(craftings[craftings_data.size()]);
 		craftings.remove_at(craftings_data.size());
 	}
+	if (is_node_ready())
+		_schedule_craftings();
 }
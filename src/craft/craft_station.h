@@ -6,6 +6,8 @@
 #include "base/node_inventories.h"
 #include "core/inventory.h"
 #include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 
 using namespace godot;
 
@@ -15,6 +17,10 @@ class Crafting : public Resource {
 private:
 	int recipe_index = 0;
 	float time = 0.0f;
+	// While a CraftingScheduler clock runs it, the crafting keeps its absolute
+	// completion time on that clock and time is only read back when it stops.
+	int clock = -1;
+	double due_time = 0.0;
 
 protected:
 	static void _bind_methods();
@@ -26,6 +32,11 @@ public:
 	float get_time() const;
 	bool is_finished() const;
 	void process(float delta);
+	void schedule(const int new_clock);
+	void unschedule();
+	bool is_scheduled() const;
+	int get_clock() const;
+	double get_due_time() const;
 	Dictionary serialize() const;
 	void deserialize(const Dictionary data);
 };
@@ -53,10 +64,59 @@ private:
 	bool _use_items(const Ref<Recipe> &recipe);
 	void _on_input_inventory_contents_changed();
 	void _check_auto_crafts();
+	bool _uses_scheduler() const;
+	void _schedule_craftings();
+	void _unschedule_craftings();
+	void _unschedule_crafting(const Ref<Crafting> &crafting);
+	void _on_crafting_changed();
+	void _finish_due_craftings();
+
+	// Readiness of the valid recipes. The inputs' total of every item they need is
+	// kept, a change of contents only compares those totals and recounts the unmet
+	// needs of the recipes using an item whose total moved.
+	struct TrackedItem {
+		String item_id;
+		int total = 0;
+		LocalVector<int> recipes;
+		bool changed = false;
+	};
+	struct RecipeNeeds {
+		int recipe_index = 0;
+		LocalVector<int> items;
+		LocalVector<int> amounts;
+		int missing = 0;
+	};
+	LocalVector<TrackedItem> tracked_items;
+	HashMap<String, int> tracked_item_slots;
+	LocalVector<RecipeNeeds> recipe_needs;
+	HashMap<int, int> recipe_needs_by_index;
+	bool readiness_dirty = true;
+	// Tracked items the inputs reported through item_added, item_removed and
+	// batch_committed since the last refresh, only those totals are compared. Changes
+	// the inputs don't report by item (swaps, and whatever moves
+	// Inventory::get_stacks_edit_revision) and refreshes with nothing reported compare
+	// every total.
+	LocalVector<int> changed_tracked_items;
+	bool readiness_changes_reported = false;
+	bool readiness_needs_compare = false;
+	uint64_t readiness_edit_revision = 0;
+	uint64_t _get_inputs_edit_revision() const;
+	void _mark_input_item_changed(const String &item_id);
+	void _on_input_item_changed(const String &item_id, const int amount);
+	void _on_input_batch_committed(const PackedInt32Array &changed_stacks, const PackedStringArray &item_ids, const PackedInt32Array &item_deltas, const PackedInt32Array &added_stacks, const PackedInt32Array &removed_stacks);
+	void _on_input_stacks_swapped(const int stack_index, Object *other_inventory, const int other_stack_index);
+	void _rebuild_recipe_readiness();
+	void _refresh_recipe_readiness();
+	void _refresh_tracked_item(const int item_slot);
+	void _clear_reported_changes();
+	void _add_recipe_needs(RecipeNeeds &needs, const TypedArray<ItemStack> &item_stacks, const int needs_position);
+	void _count_missing_needs(RecipeNeeds &needs) const;
+	int _get_input_amount(const String &item_id) const;
 
 protected:
 	TypedArray<Crafting> craftings;
 	static void _bind_methods();
+	void _notification(int p_what);
 
 public:
 	enum ProcessingMode {
@@ -73,11 +133,14 @@ public:
 	CraftStation();
 	~CraftStation();
 	virtual void _ready() override;
+	virtual void _enter_tree() override;
+	virtual void _exit_tree() override;
 	virtual void _process(float delta);
 	virtual void _physic_process(float delta);
 	void _setup_connections();
 	void load_valid_recipes();
 	void tick(float delta);
+	void wake_craftings();
 	void add_crafting(int recipe_index, const Ref<Recipe> &recipe);
 	void remove_crafting(int crafting_index);
 	virtual void finish_crafting(int crafting_index);
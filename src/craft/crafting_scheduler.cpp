@@ -0,0 +1,181 @@
+#include "crafting_scheduler.h"
+
+#include "craft_station.h"
+#include <godot_cpp/classes/window.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/object.hpp>
+
+CraftingScheduler *CraftingScheduler::singleton = nullptr;
+
+void CraftingScheduler::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_clock", "clock"), &CraftingScheduler::get_clock);
+	ClassDB::bind_method(D_METHOD("advance", "clock", "delta"), &CraftingScheduler::advance);
+	ClassDB::bind_method(D_METHOD("get_pending_wake_ups", "clock"), &CraftingScheduler::get_pending_wake_ups);
+
+	BIND_ENUM_CONSTANT(CLOCK_PROCESS);
+	BIND_ENUM_CONSTANT(CLOCK_PHYSICS_PROCESS);
+}
+
+CraftingScheduler *CraftingScheduler::get_singleton() {
+	return singleton;
+}
+
+CraftingScheduler::CraftingScheduler() {
+	singleton = this;
+}
+
+CraftingScheduler::~CraftingScheduler() {
+	if (singleton == this)
+		singleton = nullptr;
+}
+
+void CraftingScheduler::_swap_wake_ups(const int clock, const uint32_t index, const uint32_t other_index) {
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	SWAP(heap[index], heap[other_index]);
+	wake_up_positions[clock][heap[index].station_id] = index;
+	wake_up_positions[clock][heap[other_index].station_id] = other_index;
+}
+
+void CraftingScheduler::_sift_up_wake_up(const int clock, uint32_t index) {
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		if (heap[parent].due_time <= heap[index].due_time)
+			break;
+		_swap_wake_ups(clock, parent, index);
+		index = parent;
+	}
+}
+
+void CraftingScheduler::_sift_down_wake_up(const int clock, uint32_t index) {
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	while (true) {
+		uint32_t smallest = index;
+		uint32_t left = index * 2 + 1;
+		uint32_t right = left + 1;
+		if (left < heap.size() && heap[left].due_time < heap[smallest].due_time)
+			smallest = left;
+		if (right < heap.size() && heap[right].due_time < heap[smallest].due_time)
+			smallest = right;
+		if (smallest == index)
+			break;
+		_swap_wake_ups(clock, smallest, index);
+		index = smallest;
+	}
+}
+
+void CraftingScheduler::_remove_wake_up(const int clock, const uint32_t index) {
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	wake_up_positions[clock].erase(heap[index].station_id);
+	uint32_t last = heap.size() - 1;
+	if (index != last) {
+		heap[index] = heap[last];
+		wake_up_positions[clock][heap[index].station_id] = index;
+	}
+	heap.resize(last);
+	if (index < heap.size()) {
+		// The moved entry came from a leaf, it can belong above or below the hole.
+		_sift_up_wake_up(clock, index);
+		_sift_down_wake_up(clock, wake_up_positions[clock][heap[index].station_id]);
+	}
+}
+
+SceneTree *CraftingScheduler::_get_tree() const {
+	return Object::cast_to<SceneTree>(ObjectDB::get_instance(tree_id));
+}
+
+void CraftingScheduler::connect_tree(SceneTree *tree) {
+	ERR_FAIL_NULL_MSG(tree, "'tree' is null.");
+	if (tree->get_instance_id() == tree_id)
+		return;
+	tree_id = tree->get_instance_id();
+	tree->connect("process_frame", callable_mp(this, &CraftingScheduler::_on_process_frame));
+	tree->connect("physics_frame", callable_mp(this, &CraftingScheduler::_on_physics_frame));
+}
+
+void CraftingScheduler::_on_process_frame() {
+	SceneTree *tree = _get_tree();
+	// Clocks run while the tree is paused, stations that stop processing take their
+	// craftings off them (see CraftStation::_notification).
+	if (tree == nullptr)
+		return;
+	advance(CLOCK_PROCESS, tree->get_root()->get_process_delta_time());
+}
+
+void CraftingScheduler::_on_physics_frame() {
+	SceneTree *tree = _get_tree();
+	if (tree == nullptr)
+		return;
+	advance(CLOCK_PHYSICS_PROCESS, tree->get_root()->get_physics_process_delta_time());
+}
+
+double CraftingScheduler::get_clock(const int clock) const {
+	ERR_FAIL_COND_V_MSG(clock < 0 || clock >= CLOCK_COUNT, 0.0, "The 'clock' is out of bounds.");
+	return clocks[clock];
+}
+
+void CraftingScheduler::schedule(CraftStation *station, const double due_time, const int clock) {
+	ERR_FAIL_NULL_MSG(station, "'station' is null.");
+	ERR_FAIL_COND_MSG(clock < 0 || clock >= CLOCK_COUNT, "The 'clock' is out of bounds.");
+	uint64_t station_id = station->get_instance_id();
+	for (int other_clock = 0; other_clock < CLOCK_COUNT; other_clock++) {
+		if (other_clock == clock)
+			continue;
+		const uint32_t *other_position = wake_up_positions[other_clock].getptr(station_id);
+		if (other_position != nullptr)
+			_remove_wake_up(other_clock, *other_position);
+	}
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	const uint32_t *position = wake_up_positions[clock].getptr(station_id);
+	if (position != nullptr) {
+		uint32_t index = *position;
+		bool is_sooner = due_time < heap[index].due_time;
+		heap[index].due_time = due_time;
+		if (is_sooner)
+			_sift_up_wake_up(clock, index);
+		else
+			_sift_down_wake_up(clock, index);
+		return;
+	}
+	WakeUp wake_up;
+	wake_up.due_time = due_time;
+	wake_up.station_id = station_id;
+	heap.push_back(wake_up);
+	wake_up_positions[clock].insert(station_id, heap.size() - 1);
+	_sift_up_wake_up(clock, heap.size() - 1);
+}
+
+void CraftingScheduler::unschedule(CraftStation *station) {
+	ERR_FAIL_NULL_MSG(station, "'station' is null.");
+	uint64_t station_id = station->get_instance_id();
+	for (int clock = 0; clock < CLOCK_COUNT; clock++) {
+		const uint32_t *position = wake_up_positions[clock].getptr(station_id);
+		if (position != nullptr)
+			_remove_wake_up(clock, *position);
+	}
+}
+
+void CraftingScheduler::advance(const int clock, const double delta) {
+	ERR_FAIL_COND_MSG(clock < 0 || clock >= CLOCK_COUNT, "The 'clock' is out of bounds.");
+	clocks[clock] += delta;
+	// Due stations are taken out before any is woken, what they schedule while
+	// finishing waits for the next frame even if it is already due.
+	LocalVector<WakeUp> &heap = wake_ups[clock];
+	LocalVector<uint64_t> due_station_ids;
+	while (!heap.is_empty() && heap[0].due_time <= clocks[clock]) {
+		due_station_ids.push_back(heap[0].station_id);
+		_remove_wake_up(clock, 0);
+	}
+	for (uint32_t i = 0; i < due_station_ids.size(); i++) {
+		CraftStation *station = Object::cast_to<CraftStation>(ObjectDB::get_instance(due_station_ids[i]));
+		// Honours the process mode like the station's own processing did, it is
+		// scheduled again when it can process.
+		if (station != nullptr && station->is_inside_tree() && station->can_process())
+			station->wake_craftings();
+	}
+}
+
+int CraftingScheduler::get_pending_wake_ups(const int clock) const {
+	ERR_FAIL_COND_V_MSG(clock < 0 || clock >= CLOCK_COUNT, 0, "The 'clock' is out of bounds.");
+	return wake_ups[clock].size();
+}
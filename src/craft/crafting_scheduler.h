@@ -0,0 +1,67 @@
+#ifndef CRAFTING_SCHEDULER_CLASS_H
+#define CRAFTING_SCHEDULER_CLASS_H
+
+#include <godot_cpp/classes/object.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+
+using namespace godot;
+
+class CraftStation;
+
+// Drives the craftings of every CraftStation ticked on process or physics process.
+// Each clock advances once per frame of the scene tree, stations keep the absolute
+// completion time of their craftings on it and are only woken when one is due.
+class CraftingScheduler : public Object {
+	GDCLASS(CraftingScheduler, Object);
+
+public:
+	// Same values as CraftStation::TickUpdateMethod.
+	enum Clock {
+		CLOCK_PROCESS = 0,
+		CLOCK_PHYSICS_PROCESS = 1,
+		CLOCK_COUNT = 2
+	};
+
+private:
+	static CraftingScheduler *singleton;
+
+	// Min-heap entry on due time, a station has at most one. The heap position of
+	// every entry is kept so a new due time moves it instead of adding another.
+	struct WakeUp {
+		double due_time = 0.0;
+		uint64_t station_id = 0;
+	};
+	double clocks[CLOCK_COUNT] = {};
+	LocalVector<WakeUp> wake_ups[CLOCK_COUNT];
+	HashMap<uint64_t, uint32_t> wake_up_positions[CLOCK_COUNT];
+	uint64_t tree_id = 0;
+
+	void _swap_wake_ups(const int clock, const uint32_t index, const uint32_t other_index);
+	void _sift_up_wake_up(const int clock, uint32_t index);
+	void _sift_down_wake_up(const int clock, uint32_t index);
+	void _remove_wake_up(const int clock, const uint32_t index);
+	SceneTree *_get_tree() const;
+	void _on_process_frame();
+	void _on_physics_frame();
+
+protected:
+	static void _bind_methods();
+
+public:
+	static CraftingScheduler *get_singleton();
+
+	CraftingScheduler();
+	~CraftingScheduler();
+	void connect_tree(SceneTree *tree);
+	double get_clock(const int clock) const;
+	void schedule(CraftStation *station, const double due_time, const int clock);
+	void unschedule(CraftStation *station);
+	void advance(const int clock, const double delta);
+	int get_pending_wake_ups(const int clock) const;
+};
+
+VARIANT_ENUM_CAST(CraftingScheduler::Clock);
+
+#endif // CRAFTING_SCHEDULER_CLASS_H
@@ -22,6 +22,7 @@
 #include "core/grid_inventory.h"
 #include "core/loot_generator.h"
 #include "craft/craft_station.h"
+#include "craft/crafting_scheduler.h"
 
 #ifdef TOOLS_ENABLED
 #include "editor/base_inventory_editor.h"
@@ -53,6 +54,8 @@
 
 using namespace godot;
 
+static CraftingScheduler *crafting_scheduler = nullptr;
+
 void initialize_gdextension_types(ModuleInitializationLevel p_level) {
 	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
 		GDREGISTER_CLASS(CraftStationType);
@@ -76,6 +79,9 @@ void initialize_gdextension_types(ModuleInitializationLevel p_level) {
 		GDREGISTER_CLASS(LootGenerator);
 		GDREGISTER_CLASS(CraftStation);
 		GDREGISTER_CLASS(Crafting);
+		GDREGISTER_CLASS(CraftingScheduler);
+		crafting_scheduler = memnew(CraftingScheduler);
+		Engine::get_singleton()->register_singleton("CraftingScheduler", crafting_scheduler);
 	}
 
 #ifdef TOOLS_ENABLED
@@ -112,7 +118,11 @@ void initialize_gdextension_types(ModuleInitializationLevel p_level) {
 }
 
 void uninitialize_gdextension_types(ModuleInitializationLevel p_level) {
-	// Nothing to cleanup yet
+	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
+		Engine::get_singleton()->unregister_singleton("CraftingScheduler");
+		memdelete(crafting_scheduler);
+		crafting_scheduler = nullptr;
+	}
 }
 
 extern "C" {